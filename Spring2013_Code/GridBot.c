@@ -41,6 +41,18 @@
  */
 #define DEBUG_GRID
 
+/* TELEMETRY:
+ * ==========
+ * DEFINE...........if the serial output of DEBUG_GRID should be a binary telemetry stream instead of an ASCII grid after
+ *                  every motion: each frame only holds the segments that changed since the last one, the robot's pose
+ *                  and events (such as capturing the flag), plus a few segments sent again whether they changed or not,
+ *                  so that every segment is sent at least every TLM_KEYFRAME_PERIOD frames and a host that connects late
+ *                  (or lost bytes) catches up -- draw it on the host with TelemetryDecoder (see TELEMETRY_DECODER)
+ * COMMENT-OUT......if the serial monitor should be sent ASCII grids
+ */
+#define TELEMETRY
+#define TLM_KEYFRAME_PERIOD 32
+
 /* ACTUATORS_ON:
  * ============
  * DEFINE...........if loading code to microcontroller and actuators on robot should be enabled for wheel motors,
@@ -50,6 +62,17 @@
  */
 #define ACTUATORS_ON
 
+/* PROFILE:
+ * ========
+ * DEFINE...........if the robot should count the calls to checkForBlocks, moveForward, the planner (planPath, i.e.
+ *                  branchAndBound or spaceTimePlan), followPath and displayDebugGrid (or sendTelemetry, see TELEMETRY)
+ *                  and time them with PROFILE_NOW, and print a summary to the serial monitor when asked to (the 'p'
+ *                  key in the virtual grid) and at the end of the run -- the time of a function includes the time of
+ *                  the profiled functions it calls
+ * COMMENT-OUT......if otherwise (the counters and timers compile to nothing)
+ */
+/* #define PROFILE */
+
 /* REAR_FACING_RANGE_SENSORS:
  * ==========================
  * DEFINE...........if robot has distance sensors on its posterior
@@ -59,12 +82,23 @@
 
 /* LONG_RANGE_SENSORS:
  * ===================
- * DEFINE...........if robot has long-range distance-sensing capability (2 segments) FOR EACH SIDE it can sense
- *                  (e.g. if REAR_FACING_RANGE_SENSORS is defined along with LONG_RANGE_SENSORS, it is assumed
- *                  that the robot has long range sensors on its posterior)
+ * DEFINE...........if robot has long-range distance-sensing capability (SENSOR_RANGE segments) FOR EACH SIDE it can
+ *                  sense (e.g. if REAR_FACING_RANGE_SENSORS is defined along with LONG_RANGE_SENSORS, it is assumed
+ *                  that the robot has long range sensors on its posterior) -- set SENSOR_RANGE to the number of
+ *                  segments the long-range sensors can see (2 for the Spring 2013 sensors)
  * COMMENT-OUT......if otherwise
  */
 #define LONG_RANGE_SENSORS
+#define SENSOR_RANGE 2
+
+/* SCHEDULED_SENSE:
+ * ================
+ * DEFINE...........if checkForBlocks should only read the sensors whose readings could change a decision -- segments
+ *                  that have been sensed the same way SENSE_TRUST times in a row are trusted as static until their
+ *                  last reading is SENSE_MAX_AGE reads old (the relative FRONT segment is always read)
+ * COMMENT-OUT......if every sensor should be read after every move
+ */
+#define SCHEDULED_SENSE
 
 /* REMEMBER_VISITED_NODES:
  * =======================
@@ -75,24 +109,185 @@
  */
 /* #define REMEMBER_VISITED_NODES */
 
-/* DYNAMIC_SENSE:
+/* SMART_SENSE:
+ * ============
+ * DEFINE...........if robot should keep an occupancy estimate of every segment that combines repeated readings, so that
+ *                  a segment sensed as BLOCKED after it was previously sensed as UNBLOCKED (meaning, it's probably the
+ *                  enemy robot instead of a stationary obstacle and it may move out of the way) is reopened once the
+ *                  evidence of the block decays -- stationary obstacles are never reopened, and reopening a segment
+ *                  does not make the robot recalculate its path home
+ * COMMENT-OUT......if every segment should keep whatever it was last sensed as
+ */
+#define SMART_SENSE
+
+/* TRACK_ENEMY:
+ * ============
+ * DEFINE...........if robot should fuse its sensor readings over time into a belief of which node the enemy robot is in,
+ *                  forecast where the enemy robot will be over the next ENEMY_HORIZON moves, and plan its path home
+ *                  around the nodes the enemy robot is likely to be in (requires SMART_SENSE, which is what tells the
+ *                  enemy robot apart from stationary obstacles)
+ * COMMENT-OUT......if the enemy robot should only be remembered as the BLOCKED segments it leaves behind
+ */
+#define TRACK_ENEMY
+
+/* SPACE_TIME_PLAN:
+ * ================
+ * DEFINE...........if the path home should be planned over (row, column, heading, time) instead of with branch and bound,
+ *                  so that a node the enemy robot is forecast to be in is only an obstacle at the time it is forecast to
+ *                  be there, and the robot can deliberately wait in place for the enemy robot to pass (requires
+ *                  TRACK_ENEMY)
+ * COMMENT-OUT......if the path home should be planned over (row, column) with branch and bound
+ */
+#define SPACE_TIME_PLAN
+
+/* ANYTIME_PLAN:
+ * =============
+ * DEFINE...........if a single call to the path home planner should never expand more than PLAN_BUDGET states (or
+ *                  branches) -- when the budget runs out, the robot heads along the most promising partial path found
+ *                  so far and plans again after every node until a plan finishes within the budget (set PLAN_BUDGET
+ *                  to the number of expansions the microcontroller can afford per control period)
+ * COMMENT-OUT......if the planner should always run until it has proven the fastest path home
+ */
+#define ANYTIME_PLAN
+#define PLAN_BUDGET 600
+
+/* PARALLEL_PLAN:
  * ==============
- * DEFINE...........if robot should mark a segment as UNBLOCKED if it currently senses it as BLOCKED but it was
- *                  previously sensed as UNBLOCKED (meaning, it's probably the enemy robot instead of a
- *                  stationary obstacle and it may move out of the way) -- *** USE WITH EXTREME CARE ***
- *                  (UNDER POSSIBLE DEVELOPMENT)
- * COMMENT-OUT......for all intents and purposes
+ * DEFINE...........if branch and bound should expand each level of its tree on PLAN_THREADS threads: every thread works
+ *                  out the moves out of its share of the branches into a buffer of its own, and the moves are then merged
+ *                  into the tree one branch at a time in the order of the tree, so the plan is the same with any number
+ *                  of threads -- the threads are started once, the first time a level is expanded, and wait between
+ *                  levels (requires VIRTUAL_BOT -- for offline runs on the PC -- and branch and bound, i.e. no
+ *                  SPACE_TIME_PLAN)
+ * COMMENT-OUT......if branch and bound should expand its tree one branch at a time
+ */
+/* #define PARALLEL_PLAN */
+#define PLAN_THREADS 4
+
+/* PLAN_TO_FLAG:
+ * =============
+ * DEFINE...........if the robot should plan its way to the flag with the same planner it uses to return home, treating
+ *                  unknown segments as open at a cost of UNKNOWN_PENALTY extra motions each, and plan again whenever
+ *                  the sensors find a block on its path (requires SPACE_TIME_PLAN)
+ * COMMENT-OUT......if the robot should head for the flag with the down-and-right heuristic (with wall hugging)
+ */
+#define PLAN_TO_FLAG
+#define UNKNOWN_PENALTY 2
+
+/* RISK_AWARE_PLAN:
+ * ================
+ * DEFINE...........if the planners should price every move by how likely it is to go as planned, on the way to the flag
+ *                  and on the way home alike: the path home may cross unknown segments too (at UNKNOWN_PENALTY extra
+ *                  motions each, sensing them before driving into them), and a move across a segment the enemy robot
+ *                  was seen blocking not long ago (reopened by SMART_SENSE and not sensed since) costs ENEMY_PENALTY
+ *                  extra motions
+ * COMMENT-OUT......if the path home should only cross UNBLOCKED segments, all at one motion each
+ */
+#define RISK_AWARE_PLAN
+#define ENEMY_PENALTY 2
+
+/* ASYNC_SENSE:
+ * ============
+ * DEFINE...........if the sensors should be sampled in the background (by a timer interrupt on the microcontroller, or
+ *                  by a producer thread standing in for it in the virtual grid) into a lock-free ring buffer, so that
+ *                  checkForBlocks only takes the newest readings instead of waiting on the sensors -- it still reads
+ *                  the sensors directly when there is no reading from the robot's current position and heading yet
+ * COMMENT-OUT......if checkForBlocks should always read the sensors itself
+ */
+/* #define ASYNC_SENSE */
+
+/* ASYNC_OUTPUT:
+ * =============
+ * DEFINE...........if the serial output of DEBUG_GRID (telemetry frames, ERROR messages, profiles) should be written into
+ *                  a ring buffer of TX_RING_SIZE bytes that the UART interrupt empties in the background (a thread stands
+ *                  in for it when AVRBot is built for a PC), so printing never holds up the robot -- a telemetry frame or
+ *                  a line of text that does not fit in what is left of the ring is dropped whole (and counted), so the
+ *                  host never sees a record cut in two (requires TELEMETRY, since an ASCII grid does not fit in the ring;
+ *                  TX_RING_SIZE must be a power of 2, no bigger than 128)
+ * COMMENT-OUT......if printing should wait for every byte to go out
+ */
+#define ASYNC_OUTPUT
+#define TX_RING_SIZE 128
+
+/* EXPLORE:
+ * ========
+ * DEFINE...........if the robot should map the arena before going for the flag (e.g. on practice runs): it repeatedly
+ *                  heads for the nearest frontier -- the position and heading, fewest motions away, from which one of
+ *                  its sensors would see an unknown segment -- until every segment it can reach with its sensors is
+ *                  known, and then reports how many motions that took next to a zig-zag sweep of the same arena
+ * COMMENT-OUT......if the robot should go straight for the flag
+ */
+/* #define EXPLORE */
+
+/* PERSIST_MAP:
+ * ============
+ * DEFINE...........if the map the robot learned (horizSeg and vertSeg, with how confident it is in each segment) should
+ *                  be saved at the end of every run -- to MAP_FILE in the virtual grid, or to EEPROM on the
+ *                  microcontroller -- and loaded at startup as a prior, so the robot can plan with it from the first
+ *                  step (the sensors still confirm every loaded segment before it is trusted; delete MAP_FILE, or
+ *                  clear the EEPROM, when the arena changes a lot)
+ * COMMENT-OUT......if every run should start with every segment off the border unknown
+ */
+/* #define PERSIST_MAP */
+
+/* BENCHMARK:
+ * ==========
+ * DEFINE...........if the virtual grid should skip the interactive test and instead run both ways of getting to the flag
+ *                  (the heuristic, and the planner of PLAN_TO_FLAG) on BENCH_LAYOUTS random layouts of blocks (seeded
+ *                  with BENCH_SEED, so every run gets the same layouts), and report how many motions each took and how
+ *                  that compares with the fewest motions possible with every block known from the start (requires
+ *                  VIRTUAL_BOT and PLAN_TO_FLAG)
+ * COMMENT-OUT......if otherwise
+ */
+/* #define BENCHMARK */
+#define BENCH_LAYOUTS 200
+#define BENCH_SEED 2013
+
+/* GRIDBOT_LIBRARY:
+ * ================
+ * DEFINE...........if GridBot.c should be built as a library for offline tools instead of as a program: main is left
+ *                  out, and the world model, the sensors of the virtual grid and the planners answer batches of queries
+ *                  through the C API in GridBot.h (requires VIRTUAL_BOT -- build.sh builds it as libGridBot.a, where
+ *                  only the gridBot functions of GridBot.h are global symbols)
+ * COMMENT-OUT......if otherwise
+ */
+/* #define GRIDBOT_LIBRARY */
+
+/* TELEMETRY_DECODER:
+ * ==================
+ * DEFINE...........if the virtual grid should instead read a telemetry stream (see TELEMETRY) from standard input and draw
+ *                  every frame of it with displayDebugGrid, passing any text in the stream (e.g. ERROR messages) through
+ *                  (requires VIRTUAL_BOT and DEBUG_GRID -- build.sh builds it as TelemetryDecoder)
+ * COMMENT-OUT......if otherwise
  */
-/* #define SMART_SENSE */
+/* #define TELEMETRY_DECODER */
 
 /* }}} */
 /*{{{ PLATFORM-DEPENDENT MACROS */
 
+#if defined(ASYNC_OUTPUT) && !defined(VIRTUAL_BOT) && defined(DEBUG_GRID)
+    #define TX_RING             /* serial output goes through txRing */
+    #if defined(__linux__) || defined(__APPLE__)
+        #define TX_THREAD       /* AVRBot built for a PC (e.g. by build.sh) -- a thread stands in for the UART interrupt */
+    #endif
+#endif
+#if ((defined(ASYNC_SENSE) || defined(PARALLEL_PLAN)) && defined(VIRTUAL_BOT)) || defined(TX_THREAD)
+    #define _POSIX_C_SOURCE 199506L /* pthreads and nanosleep in ANSI C -- must come before any #include */
+#endif
+#ifdef TX_THREAD
+    #define _XOPEN_SOURCE 500       /* vsnprintf in ANSI C (avr-libc always has it) -- must come before any #include */
+#endif
+
 /* CLEAR and ERROR: */
 /* ================ */
 #include <stdlib.h>     /* malloc, free, exit */
+#include <limits.h>     /* CHAR_BIT */
+#ifdef GRIDBOT_LIBRARY
+    #include "GridBot.h"
+#endif
 #ifdef VIRTUAL_BOT          /* >>> PC test environment <<< */
     #include <stdio.h>
+    #include <stdarg.h> /* va_list -- serialPrintf */
     #include <string.h> /* strncpy, strlen */
     #define ERROR(msg) fprintf(stderr, msg);
     #ifdef _WIN32
@@ -102,8 +297,9 @@
     #endif
 #elif defined(DEBUG_GRID)   /* >>> microcontrollers connected to serial monitor <<< */
     #include <stdio.h>
-    #define CLEAR printf("\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n");
-    #define ERROR(msg) printf(msg);
+    #include <stdarg.h> /* va_list -- serialPrintf */
+    #define CLEAR serialPrintf("\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n");
+    #define ERROR(msg) serialPrintf(msg);
 #else                       /* >>> microcontrollers *NOT* connected to serial monitor <<< */
     #define CLEAR ;
     #define ERROR(msg) ; /* LL: add your error-message mechanism definition here
@@ -120,6 +316,47 @@
     struct termios oldt, newt;  /* terminal I/O settings */
 #endif
 
+/* MEMORY_BARRIER: */
+/* =============== */
+/* keeps memory accesses from being reordered across it -- orders the lock-free sample ring of ASYNC_SENSE and the TX
+   ring of ASYNC_OUTPUT */
+#if defined(VIRTUAL_BOT) || defined(TX_THREAD)
+    #if defined(ASYNC_SENSE) || defined(PARALLEL_PLAN) || defined(TX_THREAD)
+        #include <pthread.h>    /* pthread_create, pthread_join, pthread_mutex_lock, pthread_cond_wait */
+        #include <time.h>       /* nanosleep */
+    #endif
+    #define MEMORY_BARRIER() __sync_synchronize();  /* the producer thread may run on another core */
+#else
+    #define MEMORY_BARRIER() __asm__ __volatile__("" ::: "memory"); /* one core: only the compiler can reorder */
+#endif
+
+/* FLASH_TABLE: */
+/* ============ */
+/* keeps a const table in program memory instead of RAM on the AVR, where it can only be read with the pgm_read_*
+   functions of avr-libc -- flashByte and flashPtr read an entry of such a table anywhere */
+#ifdef __AVR__
+    #include <avr/pgmspace.h>   /* PROGMEM, pgm_read_byte, pgm_read_word */
+    #define FLASH_TABLE         PROGMEM
+    #define flashByte(p)        pgm_read_byte(p)
+    #define flashPtr(type, p)   ((type)pgm_read_word(p))
+#else
+    #define FLASH_TABLE
+    #define flashByte(p)        (*(p))
+    #define flashPtr(type, p)   (*(p))
+#endif
+
+/* PROFILE_NOW: */
+/* ============ */
+/* reads the clock the profiled functions are timed with (see PROFILE) */
+#ifdef PROFILE
+    #ifdef VIRTUAL_BOT
+        #include <time.h>   /* clock */
+        #define PROFILE_NOW() ((unsigned long)clock())  /* processor time, CLOCKS_PER_SEC ticks per second */
+    #else
+        #define PROFILE_NOW() 0UL   /* LL: read a free-running cycle counter here (e.g. TCNT1 plus its overflows) */
+    #endif
+#endif
+
 /*}}}*/
 /*{{{ DECLARATIONS */
 
@@ -137,6 +374,8 @@ int getNumDigits(int);
 #define NUM_HORIZ_SEG_COLS  NUM_COLS                /* number of columns of horizontal segments  */
 #define NUM_VERT_SEG_ROWS   NUM_ROWS                /* number of rows of vertical segments */
 #define NUM_VERT_SEG_COLS   (NUM_COLS + 1)
+#define NUM_INNER_SEGMENTS  ((NUM_HORIZ_SEG_ROWS - 2) * NUM_HORIZ_SEG_COLS + NUM_VERT_SEG_ROWS * (NUM_VERT_SEG_COLS - 2))
+                                                    /* number of segments off the border of the grid */
 #define NUM_DIRECTIONS      4
 
 /* ADT's: */
@@ -166,19 +405,19 @@ typedef enum
         VISITED
     } Node;                     /* indicates whether or not a node has been visited */
 #endif
+    typedef unsigned short NodeId;  /* node and heading packed into 16 bits: (row * NUM_COLS + col) << 2 | heading */
     typedef struct
     {
-        int row;        /* row of node */
-        int col;        /* column of node */
-        int motions;    /* number of motions ((moves + turns) it took to get to this node from start of path) */
-        Direction dir;  /* direction that robot is facing when it enters this node */
+        NodeId id;              /* node, and direction that robot is facing when it enters this node */
+        unsigned short motions; /* number of motions ((moves + turns) it took to get to this node from start of path) */
     } Tile;                     /* used to return coordinates from functions */
-    typedef struct _PathNode
+    typedef struct
     {
-        Tile tile;
-        struct _PathNode *next;
-    } PathNode;                 /* linked list node for path home */
-    typedef PathNode *Path;     /* linked list for path home */
+        int length;             /* number of nodes */
+        NodeId *id;             /* id[i]: i-th node of the path, with the heading it is entered with */
+        unsigned short *motions;/* motions[i]: number of motions it takes to get to id[i] from the start of the path */
+    } PathNodes;                /* nodes of a path, stored as one array per field right behind the struct (see newPath) */
+    typedef PathNodes *Path;    /* path home -- NULL for a path with no nodes */
     typedef struct _PathListNode
     {
         Path path;
@@ -186,6 +425,24 @@ typedef enum
     } PathListNode;                 /* linked list node for collection of possible paths */
     typedef PathListNode *PathList; /* linked list for collection of possible paths */
 
+/* Node IDs: */
+/* ========== */
+/* #defines are used to mimic inline functions, which do not exist in ANSI C */
+#define nodeId(row, col, h)     ((NodeId)((((row) * NUM_COLS + (col)) << 2) | (h)))   /* packs a node and a heading */
+#define idRow(id)               ((int)((id) >> 2) / NUM_COLS)   /* row of the node of a NodeId */
+#define idCol(id)               ((int)((id) >> 2) % NUM_COLS)   /* column of the node of a NodeId */
+#define idDir(id)               ((Direction)((id) & 3))         /* heading of a NodeId */
+#define sameNode(a, b)          (((a) >> 2) == ((b) >> 2))      /* TRUE if two NodeIds are on the same node */
+typedef char nodeIdCheck[NUM_NODES * NUM_DIRECTIONS <= 65536 ? 1 : -1]; /* fails to compile if the grid outgrows NodeId */
+
+/* Direction Algebra: */
+/* ================== */
+/* #defines are used to mimic inline functions, which do not exist in ANSI C */
+#define relToAbs(heading, rel)  ((Direction)(((heading) + (rel)) & 3))    /* absolute Direction of relative Direction rel */
+#define absToRel(heading, dir)  ((Direction)(((dir) - (heading)) & 3))    /* relative Direction of absolute Direction dir */
+const signed char rowDelta[NUM_DIRECTIONS] = { -1,  0,  1,  0 };  /* change in row when moving one node, absolute Direction */
+const signed char colDelta[NUM_DIRECTIONS] = {  0,  1,  0, -1 };  /* change in column when moving one node, absolute Direction */
+
 /* Position and Orientation of Robot: */
 /* ================================== */
 int current[2];           /* [0]: current row, [1]: current column -- updates in moveForward() */
@@ -203,27 +460,73 @@ Bool haveFlag;                            /* FALSE until we've picked up flag, t
 Segment horizSeg[NUM_HORIZ_SEG_ROWS][NUM_HORIZ_SEG_COLS];
 /* 2D array comprised of all vertical Segments; BLOCKED, UNBLOCKED, or IDK -- updates in checkForBlocks() */
 Segment vertSeg[NUM_VERT_SEG_ROWS][NUM_VERT_SEG_COLS];
+#if defined(SCHEDULED_SENSE) || defined(SMART_SENSE)
+    #define SEGMENT_INFO
+    typedef struct
+    {
+    #ifdef SCHEDULED_SENSE
+        unsigned char agree;    /* number of consecutive readings that agreed with the Segment (saturates at 255) */
+        unsigned char stamp;    /* value of senseClock when the Segment was last read */
+    #endif
+    #ifdef SMART_SENSE
+        signed char evidence;   /* occupancy evidence, -OCC_MAX to OCC_MAX: > 0 probably blocked, < 0 probably unblocked */
+        unsigned char flags;    /* SEEN_OPEN and/or REOPENED */
+    #endif
+    } SegmentInfo;              /* how much the robot trusts its memory of a Segment */
+    /* per-Segment knowledge state, parallel to horizSeg and vertSeg -- updates in checkForBlocks() */
+    SegmentInfo horizSegInfo[NUM_HORIZ_SEG_ROWS][NUM_HORIZ_SEG_COLS];
+    SegmentInfo vertSegInfo[NUM_VERT_SEG_ROWS][NUM_VERT_SEG_COLS];
+    unsigned char senseClock;   /* number of calls to checkForBlocks() (wraps every 256 calls) */
+#endif
 
 /* Return Home Algorithm */
 /* ===================== */
 PathList pathsHome;                         /* collection of possible paths home */
 int pathSize;                               /* length of paths in pathsHome */
 PathListNode *pathListNodeContainingTile(Tile, PathList, int *);
+Path newPath(int);                          /* allocates a Path of a number of nodes, NULL if out of memory */
 void freePath(Path *);                      /* deallocates a Path */
 void freePathList(PathList *);              /* deallocates a PathList (quad tree) */
 int pathLength(Path);                       /* returns the length of a Path */
-PathNode *lastPathNode(Path);               /* returns a pointer to the last node in a Path */
-Tile relCoordinate(Direction, Tile);        /* returns Tile (i.e. node coordinate) in relative direction from a given Tile */
+Tile pathTile(Path, int);                   /* returns a node of a Path with the motions to get there */
+Tile lastPathNode(Path);                    /* returns the last node in a Path */
+Tile relCoordinate(Direction, Tile);        /* returns Tile (i.e. node coordinate) in relative direction from a given Tile, entered facing that way */
 Segment segRelFrom(Direction, Tile);        /* returns status of segment adjacent to a Tile in relative Direction */
-void returnHome(void);                      /* moves robot back to node (0, 0) in fastest possible way */
 Path *copyPath(Path);                       /* returns a dynamically allocated copy of a Path */
 Path *appendPathNode(Path, Tile);           /* returns a pointer to a new Path that is a copy of the first one with a Tile appended to it */
 Bool expandFirstBranchInTree(PathList);     /* expands the first Path in the PathList argument and returns TRUE if found a path home */
+int branchMoves(Path, Tile [NUM_DIRECTIONS]); /* returns the nodes a Path can be extended to (-1 if it already ends home) */
+Bool mergeBranchMove(PathList, Tile);       /* adds the first Path in the PathList extended by a node to pathsHome, TRUE if home */
 Bool expandTreeOneLevel(PathList);          /* expands the PathList by extending each Path by one Tile in each possible direction */
 PathList *pruneTree(PathList *);            /* removes old, redundant, and dead-end Paths from the PathList */
-Path *branchAndBound(void);                 /* returns a pointer to the fastest path home (one with the fewest number of spaces) */
-void returnHome(void);                      /* moves the robot to upper-left-most node in the grid as quickly as possible with known info */
-Bool followPath(Path);                      /* moves along a specified path -- all Nodes in path must be adjacent with no blocks in the way */
+#ifdef PARALLEL_PLAN
+    #ifndef VIRTUAL_BOT
+        #error "PARALLEL_PLAN requires VIRTUAL_BOT"
+    #endif
+    #ifdef SPACE_TIME_PLAN
+        #error "PARALLEL_PLAN requires branch and bound -- comment out SPACE_TIME_PLAN"
+    #endif
+    typedef struct
+    {
+        PathList *branches;             /* branches of the level, in the order of pathsHome */
+        Tile (*moves)[NUM_DIRECTIONS];  /* moves[i]: nodes branches[i] can be extended to -- written by one thread only */
+        int *numMoves;                  /* numMoves[i]: return value of branchMoves for branches[i] */
+        int first, last;                /* the thread's share of the level: branches[first] to branches[last - 1] */
+    } LevelShare;
+    void *expandShare(void *);          /* finds the moves out of every branch in a LevelShare */
+    void startPlanPool(void);           /* starts the worker threads that expand the shares of a level */
+    void stopPlanPool(void);            /* stops the worker threads */
+#endif
+typedef struct
+{
+    Path *path;     /* path home (or toward home if the budget ran out first), NULL if there is no path home */
+    Bool optimal;   /* TRUE if the search finished, i.e. path is proven to be the fastest path home */
+} PlanResult;                               /* result of planning the path home (or to planGoal) */
+PlanResult branchAndBound(void);            /* returns a pointer to the fastest path home (one with the fewest number of spaces) */
+void returnHome(void);                      /* advances the robot toward node (0, 0) by one state of the mission (see Mission) */
+void followPath(void);                      /* moves to the next node of fastestPath -- all Nodes in the path must be adjacent */
+Bool pathObstructed(Path, int);             /* returns TRUE if the rest of a path can no longer be followed as planned */
+PlanResult planPath(void);                  /* plans the path from the current node to planGoal */
 #ifdef VIRTUAL_BOT
     char *DirectionToStr(Direction);
     void displayPath(Path);
@@ -231,7 +534,39 @@ Bool followPath(Path);                      /* moves along a specified path -- a
     int getTileIndex(int, int);
 #endif
 Path *fastestPath = NULL;                   /* pointer to fastest route home */
-Bool segmentsChanged = FALSE;
+int pathCursor;                             /* index of the next node of fastestPath to move to -- updates in followPath() */
+Bool followStarted;                         /* FALSE until followPath() has moved to the first node of fastestPath */
+Bool planOptimal = TRUE;                    /* FALSE while fastestPath is only the best partial path found within PLAN_BUDGET */
+int planExpansions;                         /* number of states (or branches) expanded by the current call to planPath */
+int planGoal[2] = { 0, 0 };                 /* node planPath plans to (branch and bound always plans home) -- updates in startPath() */
+Bool planThroughUnknown = FALSE;            /* TRUE if planPath may cross IDK Segments (at UNKNOWN_PENALTY extra motions each) */
+#ifdef RISK_AWARE_PLAN
+    #define homeThroughUnknown  TRUE        /* the path home may cross IDK Segments too */
+#else
+    #define homeThroughUnknown  FALSE
+#endif
+#define SEG_IMPASSABLE  (-1)                /* returned by moveRisk for a Segment no move can cross */
+int moveRisk(Segment *);                    /* returns the extra motions a move across a Segment is expected to cost */
+/* Cost tables answer many related path queries with one sweep over (row, column, heading), priced like the planners
+   (see moveRisk) but with no enemy robot and no waiting: from one state to every state, or from every state to a node */
+#define COST_UNREACHED  255                 /* cost of a state that cannot be reached (or cannot reach the node) */
+typedef unsigned char CostTable[NUM_ROWS][NUM_COLS][NUM_DIRECTIONS];
+void costsFrom(int, int, Direction, CostTable); /* fewest motions from one state (row, col, heading) to every state */
+void costsTo(int, int, CostTable);          /* fewest motions from every state to a node, whatever the heading there */
+void costSweep(CostTable, Bool);            /* sweeps outward from the states already at 0 (backward if TRUE) */
+void costRelax(CostTable, int, int, Direction, int, int *); /* lowers the cost of a state, keeps track of the highest */
+#ifdef ANYTIME_PLAN
+    #define planBudgetSpent()   (planExpansions >= PLAN_BUDGET)
+#else
+    #define planBudgetSpent()   FALSE
+#endif
+#define homeDistance(row, col)  flashByte(&homeBound[nodeIndex(row, col)])    /* number of moves from a node to home if nothing is in the way */
+#define goalDistance(row, col)  (abs((row) - planGoal[ROW]) + abs((col) - planGoal[COL]))  /* same, to planGoal */
+#define turnsBetween(from, to)  (abs((int)(from) - (int)(to)) == 3 ? 1 : abs((int)(from) - (int)(to)))  /* 90 degree turns from one heading to another */
+Bool segmentsChanged = FALSE;              /* TRUE if the last call to checkForBlocks() changed horizSeg or vertSeg */
+#ifdef SMART_SENSE
+    Bool segmentsOpened = FALSE;            /* TRUE if the last call to checkForBlocks() sensed an IDK Segment UNBLOCKED */
+#endif
 
 #ifdef VIRTUAL_BOT
 /* Virtual Objects -- VIRTUAL GRID ONLY */
@@ -240,6 +575,12 @@ Bool segmentsChanged = FALSE;
        have been sensed by the robot. Up to 13 segments will be blocked based on competition specification of blocks. */
     Segment blockedHorizSeg[NUM_HORIZ_SEG_ROWS][NUM_HORIZ_SEG_COLS];
     Segment blockedVertSeg[NUM_VERT_SEG_ROWS][NUM_VERT_SEG_COLS];
+    /* The same blocks packed into rows of bits (grid border included) so that a sensor ray can be cast with bit scans:
+       bit i of blockedHorizBits[j] is blockedHorizSeg[i][j], and bit j of blockedVertBits[i] is blockedVertSeg[i][j] */
+    #define BITS_PER_WORD   ((int)(sizeof(unsigned int) * CHAR_BIT))
+    #define WORDS_FOR(n)    (((n) + BITS_PER_WORD - 1) / BITS_PER_WORD)
+    unsigned int blockedHorizBits[NUM_HORIZ_SEG_COLS][WORDS_FOR(NUM_HORIZ_SEG_ROWS)];
+    unsigned int blockedVertBits[NUM_VERT_SEG_ROWS][WORDS_FOR(NUM_VERT_SEG_COLS)];
     int enemy[2];   /* [0]: current row of enemy robot, [1]: current column of enemy robot -- updates in moveEnemyRobot() */
 #endif
 
@@ -257,6 +598,24 @@ Bool segmentsChanged = FALSE;
 void initializeGlobalVariables(void);   /* INITIALIZE: haveFlag, direction, current, grid, horizSeg, vertSeg */
 void initZigZagRoute(void);             /* assign row and column numbers to each Node in route, in a DOWN-RIGHT-UP-RIGHT-DOWN(...) zig-zag pattern */
 void deallocateMemory(void);            /* deallocate memory for dynamic global variables */
+#ifdef PERSIST_MAP
+    #define MAP_FILE            "GridBot.map"   /* file the map is saved to between runs -- VIRTUAL GRID ONLY */
+    #define MAP_EEPROM_ADDR     0               /* EEPROM address the map is saved to between runs -- MICROCONTROLLER ONLY */
+    #define MAP_VERSION         1               /* bumped whenever the layout of mapImage changes */
+    #define MAP_HEADER          5               /* bytes before the Segments: 'G', 'B', MAP_VERSION, NUM_ROWS, NUM_COLS */
+    #define MAP_BYTES           (MAP_HEADER + NUM_INNER_SEGMENTS + 1)  /* header, one byte per Segment, checksum */
+    #define MAP_MAX_CONFIDENCE  15              /* confidence is saved in 4 bits */
+    #define MAP_MIN_CONFIDENCE  2               /* POLICY KNOB: saved Segments with less confidence are loaded as IDK
+                                                   (higher trusts the saved map less; 0 loads every known Segment) */
+    /* saved map: the header, then one byte per Segment off the border (in innerSegment order) -- bits 0-1: the
+       Segment (BLOCKED, UNBLOCKED, or IDK), bits 2-5: confidence (0 to MAP_MAX_CONFIDENCE) -- then the checksum */
+    unsigned char mapImage[MAP_BYTES];
+    void loadMap(void);                 /* loads the saved map (if any) into horizSeg and vertSeg as a prior */
+    void saveMap(void);                 /* saves horizSeg and vertSeg for the next run */
+    Bool readMapImage(void);            /* reads mapImage from MAP_FILE or EEPROM, returns FALSE if there is none */
+    Bool writeMapImage(void);           /* writes mapImage to MAP_FILE or EEPROM, returns FALSE if it failed */
+    unsigned char mapChecksum(void);    /* returns the sum of every byte of mapImage but the checksum (mod 256) */
+#endif
 
 /* Actuators: */
 /* ========== */
@@ -264,40 +623,428 @@ void turnAbs(Direction);    /* turns robot in absolute Direction specified by in
 void turnLeft(void);        /* turns robot 90 degrees to relative LEFT */
 void turnRight(void);       /* turns robot 90 degrees to relative RIGHT */
 void turn180(void);         /* turns robot 180 degrees in relative orientation */
-void moveForward(void);     /* checks to see if segment in relative FRONT is UNBLOCKED, and then moves to that node */
+/* turn function that makes the robot face a relative Direction (NULL for FRONT) -- used in turnAbs() */
+void (*const turnTo[NUM_DIRECTIONS])(void) = { NULL, turnRight, turn180, turnLeft };
+Bool moveForward(void);     /* checks to see if segment in relative FRONT is UNBLOCKED, and then moves to that node -- FALSE if it did not move */
+void waitOneMove(void);     /* sits still for as long as one move takes */
+void stopRolling(void);     /* brings the robot to a stop if it is still rolling from the last move */
+Bool rolling = FALSE;       /* TRUE while the drive motors are still running from the last move -- moves in a row are one motion */
 void captureFlag(void);     /* captures the flag (makes virtual robot just beep a few times) */
 
+/* Mission State Machine: */
+/* ====================== */
+/* Each state either decides which state comes next or makes one motion (a move or a wait), so the mission can be
+   advanced one small step at a time between the other tasks of the scheduler. */
+typedef enum
+{
+    /* moveToFlag(): */
+    SEEK_DECIDE,        /* picks the next way toward the flag -- or starts the way home if at the flag */
+    SEEK_DOWN,          /* moves abs DOWN until there is a block, then SEEK_RIGHT */
+    SEEK_RIGHT,         /* moves abs RIGHT until there is a block, then SEEK_DECIDE */
+    SEEK_UP,            /* moves abs UP until there is a block or an opening to the right, then SEEK_AFTER_UP */
+    SEEK_AFTER_UP,      /* takes an opening to the right, or wall hugs toward the top row */
+    SEEK_AFTER_UP_HUG,  /* takes an opening to the right, or SEEK_TOP_ROW if in the top row */
+    SEEK_TOP_ROW,       /* wall hugs down from the top row until there is an opening to the right */
+    SEEK_TAKE_RIGHT,    /* takes an opening to the right, or SEEK_DECIDE */
+    SEEK_LEFT,          /* moves abs LEFT until there is a block or an opening below, then SEEK_AFTER_LEFT */
+    SEEK_AFTER_LEFT,    /* takes an opening below, or wall hugs toward the left-most column */
+    SEEK_AFTER_LEFT_HUG,/* takes an opening below, or SEEK_LEFT_COL if in the left-most column */
+    SEEK_LEFT_COL,      /* wall hugs right from the left-most column until there is an opening below */
+    SEEK_TAKE_DOWN,     /* takes an opening below, or SEEK_DECIDE */
+#ifdef PLAN_TO_FLAG
+    FLAG_PLAN,          /* plans the path to the flag through unknown Segments */
+    FLAG_FOLLOW,        /* follows fastestPath to the flag one node at a time */
+#endif
+    /* returnHome(): */
+    HOME_PLAN,          /* plans the path home */
+    HOME_FOLLOW,        /* follows fastestPath one node at a time */
+    HOME_ESCAPE,        /* there is no path home: moves abs UP until there is a block */
+    HOME_HUG_LEFT,      /* there is no path home: wall hugs to the left-most column or bottom row */
+    HOME_HUG_RIGHT,     /* there is no path home: wall hugs to the right-most column or top row */
+#ifdef EXPLORE
+    /* exploreStep(): */
+    EXPLORING,          /* heads for the nearest frontier, then EXPLORE_TO_FLAG once there is none */
+    EXPLORE_TO_FLAG,    /* heads for the flag over the map exploring made, then HOME_PLAN */
+#endif
+    /* wallHugStep(): */
+    WALL_HUG,           /* wall hugs until hug.until is met, then hug.next */
+    MISSION_DONE        /* home with the flag */
+} Mission;
+Mission mission;            /* current state of the mission -- updates in moveToFlag(), returnHome() and wallHugStep() */
+void missionStep(void);     /* runs the current state of the mission */
+Mission followReplan;       /* state of the mission once fastestPath cannot be followed as planned anymore */
+Mission followDone;         /* state of the mission once fastestPath has been followed to planGoal */
+Bool startPath(int, int, Bool, Mission, Mission);   /* plans the path to a node into fastestPath, FALSE if there is none */
+
 /* Patterned Movement: */
 /* =================== */
-void moveToFlag(void);      /* algorithm for getting to the flag */
-void wallHugUntil(Direction, Bool(*)(void *), void *);
+void moveToFlag(void);      /* advances the robot toward the flag by one state of the mission */
+void startWallHug(Direction, Bool(*)(void *), void *, Mission); /* wall hugs to relative LEFT or RIGHT until a condition is met */
+void wallHugStep(void);     /* moves one node along the wall, or ends the wall hug */
+struct
+{
+    Direction side;         /* relative LEFT or RIGHT: side of the robot the wall is on */
+    Bool (*until)(void *);  /* condition that ends the wall hug */
+    void *args;             /* argument to until */
+    Mission next;           /* state of the mission after the wall hug */
+} hug;                      /* wall hug in progress -- updates in startWallHug() */
+int hugStart;               /* row or column the current wall hug started in -- argument to some wall hug conditions */
+int troubleSpot[2] = { 0, 0 }; /* location where we are blocked to both right and bottom */
+Bool stuck = FALSE;         /* indicates a failure of first attempt to get unstuck */
 #ifdef REMEMBER_VISITED_NODES
 /* TODO: Add appropriate functions here as needed... */
 #endif
+unsigned int motionCount = 0;   /* number of motions (moves and 90 degree turns) so far -- updates in actuator functions */
+
+#ifdef EXPLORE
+/* Exploration: */
+/* ============ */
+    typedef enum
+    {
+        TURN_LEFT_MOTION,
+        TURN_RIGHT_MOTION,
+        MOVE_MOTION,
+        NO_MOTION
+    } Motion;                           /* one motion of the robot (NO_MOTION: already there) */
+    #define MOTION_UNREACHED    255     /* cost of a state motionSearch() has not reached */
+    int route[NUM_NODES][2];            /* [k][0]: row, [k][1]: column of the k-th node of the zig-zag sweep */
+    int routeTarget;                    /* index in route of the node zigZagMotions() is heading for */
+    unsigned int exploreMotions;        /* motionCount when exploring finished */
+    int zigZagSweepMotions;             /* motions a zig-zag sweep takes with the map exploring made */
+    void exploreStep(void);             /* makes one motion toward the nearest frontier (or the flag, once explored) */
+    /* returns the fewest motions from a state (row, column, heading) to one that passes a goal test -- -1 if there is none */
+    int motionSearch(int, int, Direction, Bool (*)(int, int, Direction), Motion *, int [3]);
+    Bool seesUnknown(int, int, Direction);  /* goal test: a sensor would see an unknown Segment from the state */
+    Bool atRouteTarget(int, int, Direction);/* goal test: the state is in route[routeTarget] */
+    Bool atFlag(int, int, Direction);   /* goal test: the state is in the bottom-right node */
+    int zigZagMotions(void);            /* returns the motions a zig-zag sweep of every reachable node takes on the current map */
+    int knownSegments(void);            /* returns the number of Segments off the border that are not IDK */
+#endif
+
+/* Cooperative Scheduler: */
+/* ====================== */
+typedef struct
+{
+    void (*run)(void);      /* does one short slice of the task's work -- must never block */
+    unsigned char period;   /* number of ticks between runs of the task (1: every tick) */
+} Task;                     /* job that the scheduler interleaves with the others in the robot's control period */
+#define NUM_TASKS 3
+extern const Task tasks[NUM_TASKS]; /* every task, in the order they run within a tick */
+unsigned int tickCount = 0; /* number of ticks run so far */
+Bool motionDone;            /* TRUE once the robot has made a motion (a move or a wait) in the current tick */
+void schedulerTick(void);   /* runs one tick: every task due in this tick runs once */
+void missionTask(void);     /* advances the mission until the robot makes one motion */
+void outputTask(void);      /* shows the last motion (virtual grid, or serial output) */
+void senseTask(void);       /* checks for blocks after the last motion */
 
 /* Sensors: */
 /* ======== */
-void checkForBlocks(void);
-Bool left_s(void);           /* for blocks to the left */
-Bool right_s(void);          /* for blocks to the right */
-Bool front_s(void);          /* for blocks to the front-left */
+typedef struct
+{
+    Direction dir;                  /* relative Direction the sensor faces */
+    short range;                    /* number of segments away from the robot that the sensor can see */
+    short (*read)(Direction, short);/* sensor read function -- returns distance to the first block sensed, 0 if none */
+    Bool enabled;                   /* FALSE if the sensor is not mounted on the robot */
+} SensorDescriptor;                 /* describes one distance sensor on the robot */
 #ifdef REAR_FACING_RANGE_SENSORS
-    Bool back_s(void);       /* for blocks to the back */
-#endif
-#ifdef LONG_RANGE_SENSORS
-    Bool left2_s(void);      /* for blocks to the left 2 spaces out */
-    Bool right2_s(void);     /* for blocks to the right 2 spaces out */
-    Bool front2_s(void);     /* for blocks to the front-left 2 spaces out */
-    #ifdef REAR_FACING_RANGE_SENSORS
-        Bool back2_s(void);  /* for blocks to the back 2 spaces out */
+    #define REAR_SENSORS_ENABLED TRUE
+#else
+    #define REAR_SENSORS_ENABLED FALSE
+#endif
+#ifndef LONG_RANGE_SENSORS
+    #undef SENSOR_RANGE
+    #define SENSOR_RANGE 1          /* short-range sensors only see the adjacent segment */
+#endif
+#define NUM_SENSORS 4               /* number of entries in sensors[] (enabled or not) */
+void checkForBlocks(void);          /* the sense step after a motion: ages the robot's memory by one move, then senseSegments() */
+void senseSegments(void);           /* reads every enabled sensor in sensors[] and updates horizSeg and vertSeg */
+short readRangeSensor(Direction, short);    /* casts a sensor ray in relative direction, returns distance to first block */
+void recordSegment(Segment *, Segment);     /* records a reading of a Segment in the robot's memory */
+#ifdef SEGMENT_INFO
+    SegmentInfo *segInfo(Segment *);                /* returns knowledge state of a Segment in horizSeg or vertSeg */
+#endif
+#ifdef SCHEDULED_SENSE
+    #define SENSE_TRUST     3       /* POLICY KNOB: consecutive agreeing readings before a Segment is trusted as static
+                                       (higher is more cautious; 0 trusts a Segment after its first reading) */
+    #define SENSE_MAX_AGE   8       /* POLICY KNOB: a trusted Segment is read again once its last reading is this many
+                                       calls to checkForBlocks() old (1 reads every Segment every time) */
+    Bool sensorNeeded(const SensorDescriptor *);    /* returns TRUE if reading the sensor could change a decision */
+#endif
+#ifdef ASYNC_SENSE
+    #define SAMPLE_RING_SIZE    16      /* number of samples sampleRing holds -- must be a power of 2 no bigger than 256 */
+    #define SAMPLE_PERIOD_NS    100000L /* time between samples of the producer thread -- VIRTUAL GRID ONLY */
+    typedef struct
+    {
+        unsigned short time;            /* sampleClock when the sample was taken */
+        unsigned char epoch;            /* poseEpoch when the sample was taken */
+        short hit[NUM_SENSORS];         /* reading of each sensor in sensors[] (0 for a sensor that is not enabled) */
+    } SensorSample;                     /* one timestamped reading of every sensor, taken by the producer */
+    /* Single-producer/single-consumer ring buffer: only the producer (sampleSensors) writes sampleHead, and only the
+       consumer (takeNewestSample) writes sampleTail, so neither side ever takes a lock or waits for the other. Both
+       indexes run freely and wrap every 256 samples -- an unsigned char is read and written in one go, even on AVR. */
+    SensorSample sampleRing[SAMPLE_RING_SIZE];
+    volatile unsigned char sampleHead = 0;  /* number of samples pushed so far (mod 256) */
+    volatile unsigned char sampleTail = 0;  /* number of samples popped so far (mod 256) */
+    volatile unsigned char poseEpoch = 0;   /* bumped after anything the sensors see moves -- updates in poseChanged() */
+    volatile Bool sampling = FALSE;         /* TRUE while the producer is running */
+    unsigned short sampleClock = 0;         /* number of times the producer has run -- LL: or a free-running timer */
+    void startSampling(void);               /* starts the producer */
+    void stopSampling(void);                /* stops the producer */
+    void sampleSensors(void);               /* producer: reads every sensor and pushes the readings onto sampleRing */
+    Bool takeNewestSample(short [NUM_SENSORS]); /* consumer: empties sampleRing, returns the newest readings of the current pose */
+    /* every sample taken before a call to poseChanged() is stale -- called after the robot moves or turns */
+    #ifdef VIRTUAL_BOT
+        /* The producer thread never reads current, direction or enemy, which the main thread writes as it goes:
+           poseChanged() copies them into poseSnapshot as it bumps poseEpoch, both under poseLock, and the virtual
+           sensors read from that copy. The virtual blocks are only placed before the producer starts. */
+        typedef struct
+        {
+            int at[2];          /* current, as of the last call to poseChanged() */
+            Direction heading;  /* direction, as of the last call to poseChanged() */
+            int enemyAt[2];     /* enemy, as of the last call to poseChanged() */
+        } PoseSnapshot;         /* what the virtual sensors of the producer see from */
+        PoseSnapshot poseSnapshot;
+        pthread_mutex_t poseLock = PTHREAD_MUTEX_INITIALIZER;  /* guards poseSnapshot, poseEpoch and sampling */
+        void poseChanged(void);
+    #else
+        #define poseChanged() { MEMORY_BARRIER() ++poseEpoch; }
+    #endif
+#else
+    #define poseChanged()
+#endif
+#ifdef PROFILE
+/* Profiling: */
+/* ========== */
+    typedef enum
+    {
+        PROF_SENSE,     /* checkForBlocks */
+        PROF_MOVE,      /* moveForward */
+        PROF_PLAN,      /* planPath */
+        PROF_FOLLOW,    /* followPath */
+        PROF_DISPLAY,   /* displayDebugGrid or sendTelemetry */
+        NUM_PROF_SECTIONS
+    } ProfSection;                              /* a profiled function */
+    const char *profNames[NUM_PROF_SECTIONS] = { "sense", "move", "plan", "follow", "display" };
+    unsigned int profCalls[NUM_PROF_SECTIONS];  /* number of calls to each profiled function */
+    unsigned long profTotal[NUM_PROF_SECTIONS]; /* PROFILE_NOW ticks spent in each profiled function */
+    unsigned long profMax[NUM_PROF_SECTIONS];   /* PROFILE_NOW ticks of the slowest call to each profiled function */
+    unsigned long profStart[NUM_PROF_SECTIONS]; /* PROFILE_NOW when the current call to each profiled function began */
+    void profileDump(void);                     /* prints calls and ticks of every profiled function */
+    #define PROFILE_BEGIN(s)    { profStart[s] = PROFILE_NOW(); }
+    #define PROFILE_END(s)      { unsigned long profTicks = PROFILE_NOW() - profStart[s]; \
+                                  ++profCalls[s]; profTotal[s] += profTicks; \
+                                  if (profTicks > profMax[s]) profMax[s] = profTicks; }
+    /* LL: return TRUE when a 'p' has arrived from the serial monitor */
+    #define profileRequested()  FALSE
+#else
+    #define PROFILE_BEGIN(s)
+    #define PROFILE_END(s)
+#endif
+#ifdef SMART_SENSE
+    #define OCC_HIT             3   /* occupancy evidence added by a BLOCKED reading */
+    #define OCC_MISS            2   /* occupancy evidence removed by an UNBLOCKED reading */
+    #define OCC_MAX             12  /* occupancy evidence saturates at +/- OCC_MAX */
+    #define OCC_DECAY_PERIOD    2   /* calls to checkForBlocks() per unit of decay of a block that was once UNBLOCKED */
+    #define SEEN_OPEN           1   /* SegmentInfo flag: Segment has been sensed as UNBLOCKED at least once */
+    #define REOPENED            2   /* SegmentInfo flag: Segment was reopened by decay and has not been sensed since */
+    void decayOccupancy(void);          /* decays evidence of blocks that were once UNBLOCKED, reopening them at 0 */
+    unsigned char segConfidence(Segment *); /* returns confidence (0 to OCC_MAX) in the robot's memory of a Segment */
+    Bool segSuspect(Segment *);         /* returns TRUE if a BLOCKED Segment was once UNBLOCKED (probably the enemy) */
+#endif
+
+#ifdef TRACK_ENEMY
+/* Enemy Robot Tracking: */
+/* ===================== */
+    #ifndef SMART_SENSE
+        #error "TRACK_ENEMY requires SMART_SENSE"
+    #endif
+    #define ENEMY_SCALE         1024    /* enemyBelief of every node adds up to ENEMY_SCALE (i.e. probability 1) */
+    #define ENEMY_FLOOR         (ENEMY_SCALE / NUM_NODES)   /* belief given to a node behind a suspect block before weighing it */
+    #define ENEMY_HORIZON       3       /* number of moves ahead that the position of the enemy robot is forecast */
+    #define ENEMY_STAY_SHARE    2       /* the enemy robot is assumed to stay put for 1 of every ENEMY_STAY_SHARE moves */
+    #define ENEMY_HIT_GAIN      8       /* likelihood ratio of the enemy robot behind a block that was once UNBLOCKED */
+    #define ENEMY_NEW_HIT_GAIN  2       /* likelihood ratio of the enemy robot behind a block sensed for the first time */
+    #define ENEMY_AVOID         64      /* POLICY KNOB: paths home avoid nodes whose forecast is at least this (out of 255)
+                                           (lower is more cautious; 256 never avoids the enemy robot) */
+    /* belief (out of ENEMY_SCALE) that the enemy robot is in each node -- updates in checkForBlocks() */
+    unsigned short enemyBelief[NUM_ROWS][NUM_COLS];
+    /* [t][row][col]: chance (out of 255) that the enemy robot is in a node t moves from now -- updates in checkForBlocks() */
+    unsigned char enemyForecast[ENEMY_HORIZON + 1][NUM_ROWS][NUM_COLS];
+    Bool avoidEnemy;                    /* TRUE if the path home being planned or followed avoids enemyForecast */
+    void initializeEnemyTracker(void);  /* the enemy robot starts in the far corner, on the flag */
+    void predictEnemy(unsigned short [NUM_ROWS][NUM_COLS]);     /* moves a belief forward by one move of the enemy robot */
+    void observeEnemyRay(Direction, short, short);  /* folds one sensor reading (absolute Direction) into enemyBelief */
+    void updateEnemyForecast(void);     /* normalizes enemyBelief and recalculates enemyForecast from it */
+    unsigned char enemyChance(int, int, int);       /* returns the chance of the enemy robot in a node a number of moves from now */
+    void enemyBestGuess(int [2]);       /* returns the most likely node of the enemy robot */
+#endif
+
+#ifdef SPACE_TIME_PLAN
+/* Space-Time Planning: */
+/* ==================== */
+    #ifndef TRACK_ENEMY
+        #error "SPACE_TIME_PLAN requires TRACK_ENEMY"
+    #endif
+    #define ST_TIMES        (ENEMY_HORIZON + 1) /* time layers: 0 to ENEMY_HORIZON moves from now (the last one stands for every later move too) */
+    #define ST_UNREACHED    255                 /* stCost of a state that has not been reached */
+    /* stCost[t][row][col][heading]: fewest motions (moves, 90 degree turns, and waits) from the current state to a state */
+    unsigned char stCost[ST_TIMES][NUM_ROWS][NUM_COLS][NUM_DIRECTIONS];
+    /* #defines are used to mimic inline functions, which do not exist in ANSI C */
+    #define stThreat(row, col, t)   (avoidEnemy && enemyChance(row, col, t) >= ENEMY_AVOID) /* node is an obstacle at time t */
+    #define stLater(t)              ((t) < ENEMY_HORIZON ? (t) + 1 : (t))                   /* time layer after a move or wait */
+    #define stPassable(seg)         (moveRisk(seg) != SEG_IMPASSABLE)                       /* a move can cross it */
+    #define stStep(seg)             (1 + moveRisk(seg))                                     /* cost of a move across it */
+    /* stExpanded: bit ((t * NUM_ROWS + row) * NUM_COLS + col) * NUM_DIRECTIONS + heading is set once a state is expanded */
+    #define ST_STATES       (ST_TIMES * NUM_NODES * NUM_DIRECTIONS)
+    unsigned char stExpanded[(ST_STATES + CHAR_BIT - 1) / CHAR_BIT];
+    #define stBit(t, row, col, h)   ((((t) * NUM_ROWS + (row)) * NUM_COLS + (col)) * NUM_DIRECTIONS + (h))
+    PlanResult spaceTimePlan(void);         /* returns the path to planGoal with the fewest motions, NULL if there is none */
+    void stReach(int, int, int, Direction, int);    /* records the cost of a state if it is cheaper than before */
+    Path *stBacktrack(int, int, int, Direction);    /* builds the path that reaches a state (t, row, col, heading) */
+    int stWalkBack(int, int, int, Direction, Path); /* walks back from a state, counting (and filling in) its nodes */
+    Path *stBestSoFar(void);                /* builds the partial path that gets closest to planGoal */
+#endif
+#ifdef PLAN_TO_FLAG
+    #ifndef SPACE_TIME_PLAN
+        #error "PLAN_TO_FLAG requires SPACE_TIME_PLAN"
+    #endif
+    Bool planToFlag = TRUE;                 /* FALSE to head for the flag with the heuristic instead (see BENCHMARK) */
+#endif
+#ifdef BENCHMARK
+    #if !defined(VIRTUAL_BOT) || !defined(PLAN_TO_FLAG)
+        #error "BENCHMARK requires VIRTUAL_BOT and PLAN_TO_FLAG"
+    #endif
+    #define BENCH_BLOCKS        13      /* blocked segments in each layout (the most the competition allows) */
+    #define BENCH_MAX_TICKS     400     /* a run that takes more ticks than this is counted as stuck */
+    void runBenchmark(void);            /* runs both ways of getting to the flag on every layout and reports */
+    void randomLayout(void);            /* places BENCH_BLOCKS random blocks, with the flag reachable from the start space */
+    Bool flagReachable(void);           /* returns TRUE if the flag can be reached from the start space in the virtual grid */
+    int benchRun(Bool, unsigned int *, Direction *); /* runs one mission on the current layout, returns ticks taken (-1 if stuck) */
+    Segment *virtualBlock(Segment *);   /* returns the Segment of the virtual grid at the same place as one of horizSeg or vertSeg */
+    void oracleCosts(int *, int [NUM_DIRECTIONS], int *); /* fewest motions possible on the current layout, knowing it all */
+    void reportRatios(const char *, double *, int); /* prints the distribution of some competitive ratios */
+    int compareRatios(const void *, const void *);  /* qsort comparison of two competitive ratios */
+#endif
+#ifdef GRIDBOT_LIBRARY
+/* Library API: */
+/* ============ */
+    #ifndef VIRTUAL_BOT
+        #error "GRIDBOT_LIBRARY requires VIRTUAL_BOT"
     #endif
+    /* GridBot.h mirrors the grid and the values of Segment and Direction -- these fail to compile if they ever differ */
+    typedef char gridBotSizeCheck[GRIDBOT_ROWS == NUM_ROWS && GRIDBOT_COLS == NUM_COLS ? 1 : -1];
+    typedef char gridBotValueCheck[GRIDBOT_BLOCKED == BLOCKED && GRIDBOT_UNBLOCKED == UNBLOCKED && GRIDBOT_IDK == IDK
+                                   && GRIDBOT_UP == UP && GRIDBOT_RIGHT == RIGHT && GRIDBOT_DOWN == DOWN
+                                   && GRIDBOT_LEFT == LEFT && GRIDBOT_UNREACHED == COST_UNREACHED ? 1 : -1];
+    void loadModel(const GridBotMap *); /* loads a map into horizSeg and vertSeg, with no history of readings */
+    void storeModel(GridBotMap *);      /* stores horizSeg and vertSeg into a map */
+    int checkQuery(const GridBotQuery *);   /* returns GRIDBOT_OK if the planner can answer a query, or why not */
+    /* #defines are used to mimic inline functions, which do not exist in ANSI C */
+    #define onGrid(row, col)    ((row) >= 0 && (row) < NUM_ROWS && (col) >= 0 && (col) < NUM_COLS)
+    #define validState(s)       (onGrid((s).row, (s).col) && (s).heading >= UP && (s).heading < NUM_DIRECTIONS)
+#endif
+#if (defined(TELEMETRY) && !defined(VIRTUAL_BOT) && defined(DEBUG_GRID)) || defined(TELEMETRY_DECODER)
+/* Telemetry: */
+/* ========== */
+    #if defined(TELEMETRY_DECODER) && (!defined(VIRTUAL_BOT) || !defined(DEBUG_GRID))
+        #error "TELEMETRY_DECODER requires VIRTUAL_BOT and DEBUG_GRID"
+    #endif
+    /* Every byte from TLM_TAG up starts a record, and every byte below it is the payload of a record or plain text (the
+       ASCII of an ERROR message or a profile), so a decoder that loses a byte is back in step at the next tag. */
+    #define TLM_TAG             0x80
+    #define TLM_SEG             0x80    /* + Segment state, then the telemetry index of the Segment */
+    #define TLM_POSE            0x84    /* + direction, then (row << 4) | column */
+    #define TLM_FLAG            0x88    /* the robot captured the flag */
+    #define TLM_DONE            0x89    /* the mission is over */
+    #define TLM_FRAME_END       0x8F    /* the frame is complete -- the host draws it */
+    #define tlmKind(tag)        ((tag) & 0xFC)  /* TLM_SEG or TLM_POSE for their tags, with the state or direction taken off */
+    #define NUM_HORIZ_SEGMENTS  (NUM_HORIZ_SEG_ROWS * NUM_HORIZ_SEG_COLS)
+    #define NUM_SEGMENTS        (NUM_HORIZ_SEGMENTS + NUM_VERT_SEG_ROWS * NUM_VERT_SEG_COLS)
+    Segment *tlmSegment(int);           /* returns the Segment with a telemetry index: horizSeg, then vertSeg, row by row */
+#endif
+#if defined(TELEMETRY) && !defined(VIRTUAL_BOT) && defined(DEBUG_GRID)
+    #define SEND_TELEMETRY                  /* the robot sends telemetry */
+    #define TLM_UNSENT          0xFF        /* tlmSent entry of a Segment that is due to be sent again */
+    /* Segments sent again in every frame, whether they changed or not */
+    #define TLM_REFRESH         ((NUM_SEGMENTS + TLM_KEYFRAME_PERIOD - 1) / TLM_KEYFRAME_PERIOD)
+    unsigned char tlmSent[NUM_SEGMENTS];    /* every Segment as it was last sent to the host -- starts out as the host does */
+    int tlmRefresh = 0;                     /* telemetry index of the next Segment to send again */
+    #ifdef TX_RING
+        /* most Segments one frame sends, so that a whole frame (two bytes a Segment, two for the pose, one for
+           TLM_FLAG and one for TLM_FRAME_END) always fits in txRing -- the rest wait for the next frame */
+        #define TLM_FRAME_SEGMENTS  ((TX_RING_SIZE - 4) / 2)
+        typedef char tlmFrameCheck[TLM_FRAME_SEGMENTS > TLM_REFRESH ? 1 : -1]; /* fails to compile if TX_RING_SIZE is too small */
+    #else
+        #define TLM_FRAME_SEGMENTS  NUM_SEGMENTS
+    #endif
+    Bool tlmFlagSent = FALSE;               /* TRUE once TLM_FLAG has been sent */
+    void sendTelemetry(void);               /* sends one frame: what changed since the last one */
+#endif
+#if defined(VIRTUAL_BOT) || defined(DEBUG_GRID)
+/* Serial Output: */
+/* ============== */
+    int serialPrintf(const char *, ...);    /* printf to the serial monitor -- only into txRing with ASYNC_OUTPUT */
+#endif
+#ifdef TX_RING
+    #ifndef TELEMETRY
+        #error "ASYNC_OUTPUT requires TELEMETRY"
+    #endif
+    #define SERIAL_LINE_LENGTH  128         /* longest text serialPrintf can put into txRing at once */
+    #define SERIAL_BYTE_NS      87000L      /* time the UART takes to send a byte at 115200 baud -- TX_THREAD ONLY */
+    /* The main loop only pushes and the UART interrupt only pops, so each end owns one index: txHead is only written by
+       txEnd and txTail only by txDrain. Output goes in as whole records (a telemetry frame, or the text of one
+       serialPrintf): txPut writes a record past txHead, and txEnd moves txHead past it once all of it fit -- otherwise the
+       record is dropped, and the UART never sees part of it. Both indexes run freely and wrap every 256 bytes -- an
+       unsigned char is read and written in one go, even on AVR. */
+    unsigned char txRing[TX_RING_SIZE];
+    volatile unsigned char txHead = 0;      /* number of bytes of whole records pushed so far (mod 256) */
+    volatile unsigned char txTail = 0;      /* number of bytes sent so far (mod 256) */
+    unsigned char txPending = 0;            /* end of the record being pushed (mod 256) -- MAIN LOOP ONLY */
+    Bool txOverflow = FALSE;                /* TRUE once the record being pushed did not fit -- MAIN LOOP ONLY */
+    volatile Bool txRunning = FALSE;        /* TRUE while the UART interrupt (or the thread standing in for it) runs */
+    unsigned int txDropped = 0;             /* records dropped because txRing had no room left for them */
+    void startTx(void);                     /* starts emptying txRing in the background */
+    void stopTx(void);                      /* sends whatever is left in txRing and stops */
+    void txBegin(void);                     /* starts a record */
+    void txPut(int);                        /* pushes a byte of the record onto txRing, if there is room */
+    Bool txEnd(void);                       /* hands the record to the UART -- FALSE if it did not fit and was dropped */
+    Bool txDrain(void);                     /* pops a byte off txRing and sends it -- FALSE if txRing was empty */
+    #define serialBegin()       txBegin()
+    #define serialPut(c)        txPut(c)
+    #define serialEnd()         txEnd()
+#else
+    #define serialBegin()                   /* nothing to do -- every byte goes out as it is written */
+    #define serialPut(c)        putchar(c)  /* LL: write one byte to the UART */
+    #define serialEnd()         TRUE
+#endif
+#ifdef TELEMETRY_DECODER
+    void decodeTelemetry(void);         /* draws every frame of the telemetry stream on standard input */
 #endif
-Bool sense(Direction, short);     /* calls sensor function in relative direction at a specified number of segments away */
 /* Robot Memory Check Test Functions */
 /* ================================= */
 Segment segAbs(Direction);              /* returns status of adjacent segment, absolute Direction */
 Segment segAbsx(Direction, int);        /* returns status of x away segment, absolute Direction */
+Segment *segPtrAbsx(Direction, int);    /* returns pointer to x away segment, absolute Direction -- NULL if on border */
 Segment segRel(Direction);              /* returns status of adjacent segment, relative Direction */
+Segment *innerSegment(int);             /* returns pointer to the k-th segment off the border (0 to NUM_INNER_SEGMENTS - 1) */
+
+/* Grid Tables: */
+/* ============ */
+/* The neighbours of every node, the Segments between them, and how far every node is from home never change, so they
+   are looked up in const tables (in flash on the AVR, see FLASH_TABLE) instead of being worked out with bounds checks on
+   every call. gentables.sh generates them into GridTables.h for NUM_ROWS and NUM_COLS:
+     nodeNeighbour[node][dir]: node next to node (row * NUM_COLS + col) in absolute Direction dir, NO_NODE off the grid
+     nodeSegment[node][dir]:   Segment between node and that neighbour, NULL on the border of the grid
+     homeBound[node]:          fewest motions from node to home, with nothing in the way (one per move) */
+#define NO_NODE 255
+typedef char noNodeCheck[NUM_NODES < NO_NODE ? 1 : -1];    /* fails to compile if node indexes outgrow an unsigned char */
+#include "GridTables.h"        /* generated by gentables.sh */
+typedef char tableGridCheck[TABLE_ROWS == NUM_ROWS && TABLE_COLS == NUM_COLS ? 1 : -1]; /* fails to compile until gentables.sh is run for a new grid */
+/* #defines are used to mimic inline functions, which do not exist in ANSI C */
+#define nodeIndex(row, col)     ((row) * NUM_COLS + (col))                          /* node index of node (row, col) */
+#define nodeNext(node, dir)     flashByte(&nodeNeighbour[node][dir])                /* neighbour of a node, NO_NODE if none */
+#define nodeSeg(node, dir)      flashPtr(Segment *, &nodeSegment[node][dir])        /* Segment next to a node, NULL if border */
+#define segPtrAt(row, col, dir) nodeSeg(nodeIndex(row, col), dir)   /* pointer to segment adjacent to any node, absolute Direction -- NULL if on border */
 
 #ifdef VIRTUAL_BOT
     /* Console Output Test Functions */
@@ -309,16 +1056,9 @@ Segment segRel(Direction);              /* returns status of adjacent segment, r
     int getline(char *, int);       /* reads a line, returns length */
     /* Virtual Object Presence Functions */
     /* ================================= */
-    Segment blockedSegAbs(Direction);   /* indicates presence of virtual grid block on segment adjacent to current Node; absolute Direction */
-    Segment blockedSegRel(Direction);   /* indicates presence of virtual grid block on segment adjacent to current Node; relative Direction */
-    Bool enemyPresenceAbs(Direction);   /* indicates presence of virtual enemy robot in Node adjacent to current Node; absolute Direction */
-    Bool enemyPresenceRel(Direction);   /* indicates presence of virtual enemy robot in Node adjacent to current Node; relative Direction */
-    #ifdef LONG_RANGE_SENSORS
-        Segment blockedSegAbs2(Direction);   /* same as blockedSegAbs, except 2 segments down instead of 1 */
-        Segment blockedSegRel2(Direction);   /* same as blockedSegRel, except 2 segments down instead of 1 */
-        Bool enemyPresenceAbs2(Direction);   /* same as enemyPresenceAbs, except 2 Nodes down instead of 1 */
-        Bool enemyPresenceRel2(Direction);   /* same as enemyPresenceRel, except 2 Nodes down instead of 1 */
-    #endif
+    void packBlockedSegments(void);             /* packs blockedHorizSeg and blockedVertSeg into blockedHorizBits and blockedVertBits */
+    int scanBits(const unsigned int *, int, int, int);  /* returns offset of first set bit in a packed row of bits */
+    short virtualRayCast(const int [2], const int [2], Direction, short);   /* returns distance to first virtual block or enemy robot */
     /* Dynamic Virtual Grid Interaction */
     /* ================================ */
     int buffer; /* temporarily holds one character from stdin, including EOF, which is an integer */
@@ -337,6 +1077,7 @@ Segment segRel(Direction);              /* returns status of adjacent segment, r
     #define ctrlSaveFile(c)         (c == '[')
     #define ctrlSaveAsFile(c)       (c == ']')
     #define advanceRobot(c)         (c == '\n' || c == ' ')
+    #define ctrlProfile(c)          (c == 'p')
     void controlEnemyRobot(void);
     void moveEnemyRobot(Direction);
     void moveCursor(Direction);
@@ -344,12 +1085,14 @@ Segment segRel(Direction);              /* returns status of adjacent segment, r
     void toggleVertHoriz();
     void initializeTestControls(void);
     void tearDownTestControls(void);
-#elif defined(DEBUG_GRID)
+#endif
+#if defined(DEBUG_GRID) && (!defined(VIRTUAL_BOT) || defined(TELEMETRY_DECODER))
     void displayDebugGrid(void);    /* grid to be displayed on serial monitor when connected to microcontroller */
 #endif
 
 /*}}}*/
 /*{{{ MAIN ROUTINE */
+#ifndef GRIDBOT_LIBRARY
 
 #ifdef VIRTUAL_BOT
 int main(int argc, char **argv)
@@ -357,15 +1100,61 @@ int main(int argc, char **argv)
 int main(void)  /* LL: Add any parameters you wish */
 #endif
 {
+#ifdef BENCHMARK
+    runBenchmark();
+    return 0;
+#endif
+#ifdef TELEMETRY_DECODER
+    decodeTelemetry();
+    return 0;
+#endif
+#ifdef TX_RING
+    startTx();
+#endif
     initializeGlobalVariables();            /* haveFlag, direction, current, grid, horizSeg, vertSeg, route */
+#ifdef PERSIST_MAP
+    loadMap();                              /* horizSeg, vertSeg */
+#endif
 
 #ifdef VIRTUAL_BOT
     initializeTestControls();
     initializeTestVariables(argc, argv);    /* blockedHorizSeg, blockedVertSeg */
+#endif
+#ifdef ASYNC_SENSE
+    startSampling();
 #endif
     checkForBlocks();   /* check for blocks surrounding start space -- MANDATORY */
-    moveToFlag();
-    returnHome();
+#ifdef EXPLORE
+    mission = EXPLORING;
+#else
+    mission = SEEK_DECIDE;
+#endif
+    while (mission != MISSION_DONE)
+        schedulerTick();
+#ifdef ASYNC_SENSE
+    stopSampling();
+#endif
+#ifdef PARALLEL_PLAN
+    stopPlanPool();
+#endif
+#ifdef PERSIST_MAP
+    saveMap();
+#endif
+#if defined(EXPLORE) && (defined(VIRTUAL_BOT) || defined(DEBUG_GRID))
+    serialPrintf("explore: mapped %d of %d segments in %u motions (zig-zag sweep: %d motions)\n",
+           knownSegments(), NUM_INNER_SEGMENTS, exploreMotions, zigZagSweepMotions);
+#endif
+#if defined(PROFILE) && (defined(VIRTUAL_BOT) || defined(DEBUG_GRID))
+    profileDump();
+#endif
+#ifdef SEND_TELEMETRY
+    serialBegin();
+    serialPut(TLM_DONE);
+    serialEnd();
+#endif
+#ifdef TX_RING
+    stopTx();
+#endif
 
 #ifdef VIRTUAL_BOT
     tearDownTestControls();
@@ -376,17 +1165,107 @@ int main(void)  /* LL: Add any parameters you wish */
 
     return 0;
 }
+#endif
+
+/*}}}*/
+/*{{{ COOPERATIVE SCHEDULER FUNCTIONS */
+
+/* the sensors are read after the enemy robot (or serial output) gets its turn, just like after every move before */
+const Task tasks[NUM_TASKS] =
+{
+    /*  run,            period */
+    {   missionTask,    1   },
+    {   outputTask,     1   },
+    {   senseTask,      1   }
+};
+
+/* runs one tick of the robot's control period -- every task due in this tick gets one short slice of time, in order */
+void schedulerTick(void)
+{
+    int i;  /* LCV */
+
+#if !defined(VIRTUAL_BOT)
+    /* LL: wait for the start of the next control period (e.g. a timer interrupt flag) goes here */
+#endif
+    motionDone = FALSE;
+    for (i = 0; i < NUM_TASKS; ++i)
+        if (tickCount % tasks[i].period == 0)
+            (*tasks[i].run)();
+    ++tickCount;
+
+    return;
+}
+
+/* states that only decide what to do next take no time, so run states until the robot makes one motion */
+void missionTask(void)
+{
+    while (!motionDone && mission != MISSION_DONE)
+        missionStep();
+    if (mission == MISSION_DONE)
+        stopRolling();
+
+    return;
+}
+
+/* shows the last motion (and gives the enemy robot its move in the virtual grid) */
+void outputTask(void)
+{
+    if (motionDone)
+    {
+    #ifdef BENCHMARK
+        /* nothing to show, and no enemy robot to control */
+    #elif defined(VIRTUAL_BOT)
+        controlEnemyRobot();
+    #elif defined(SEND_TELEMETRY)
+        sendTelemetry();
+    #elif defined(DEBUG_GRID)
+        displayDebugGrid();
+    #endif
+    #if !defined(VIRTUAL_BOT) && defined(DEBUG_GRID) && defined(PROFILE)
+        if (profileRequested())
+            profileDump();
+    #endif
+    }
+
+    return;
+}
+
+/* always check for blocks after a motion -- sets segmentsChanged, which is used when returning home */
+void senseTask(void)
+{
+    if (motionDone)
+        checkForBlocks();
+
+    return;
+}
+
+/* runs the current state of the mission */
+void missionStep(void)
+{
+    if (mission < HOME_PLAN)
+        moveToFlag();
+    else if (mission == WALL_HUG)
+        wallHugStep();
+#ifdef EXPLORE
+    else if (mission == EXPLORING || mission == EXPLORE_TO_FLAG)
+        exploreStep();
+#endif
+    else
+        returnHome();
+
+    return;
+}
 
 /*}}}*/
 /*{{{ INITIALIZATION AND DEALLOCATION FUNCTIONS */
 
-/* returns the number of digits in a number n */
+/* returns the number of digits in a number n -- stack: one frame */
 int getNumDigits(int n)
 {
-    if (n / 10 == 0) /* make good use of integer division... */
-        return 1;
-    else
-        return 1 + getNumDigits(n / 10); /* ... and recursion */
+    int digits = 1;
+    while (n /= 10) /* make good use of integer division */
+        ++digits;
+    return digits;
 }
 
 /*  FUNCTION: initializeGlobalVariables
@@ -406,6 +1285,9 @@ int getNumDigits(int n)
 void initializeGlobalVariables(void)
 {
     int i, j;   /* loop control variables */
+#ifdef SEGMENT_INFO
+    SegmentInfo blankInfo = { 0 };
+#endif
 
     /* haven't found finish space yet */
     haveFlag = FALSE;
@@ -449,8 +1331,55 @@ void initializeGlobalVariables(void)
         vertSeg[i][NUM_VERT_SEG_COLS - 1] = BLOCKED;
     }
 
+#ifdef SEGMENT_INFO
+    /* nothing has been read yet */
+    senseClock = 0;
+    for (i = 0; i < NUM_HORIZ_SEG_ROWS; ++i)
+    {
+        for (j = 0; j < NUM_HORIZ_SEG_COLS; ++j)
+            horizSegInfo[i][j] = blankInfo;
+    }
+    for (i = 0; i < NUM_VERT_SEG_ROWS; ++i)
+    {
+        for (j = 0; j < NUM_VERT_SEG_COLS; ++j)
+            vertSegInfo[i][j] = blankInfo;
+    }
+#endif
+
+#ifdef TRACK_ENEMY
+    initializeEnemyTracker();
+#endif
+
+#ifdef EXPLORE
+    initZigZagRoute();
+#endif
+
+#ifdef SEND_TELEMETRY
+    /* the host starts out knowing this much too (see decodeTelemetry) */
+    for (i = 0; i < NUM_SEGMENTS; ++i)
+        tlmSent[i] = (unsigned char)*tlmSegment(i);
+#endif
+
+    return;
+}
+
+#ifdef EXPLORE
+/* assign row and column numbers to each Node in route, in a DOWN-RIGHT-UP-RIGHT-DOWN(...) zig-zag pattern */
+void initZigZagRoute(void)
+{
+    int i, j, k = 0;    /* LCV's */
+
+    for (j = 0; j < NUM_COLS; ++j)
+        for (i = 0; i < NUM_ROWS; ++i)
+        {
+            route[k][ROW] = j % 2 ? NUM_ROWS - 1 - i : i;
+            route[k][COL] = j;
+            ++k;
+        }
+
     return;
 }
+#endif
 
 #ifdef VIRTUAL_BOT
 /*  FUNCTION: initializeTestVariables
@@ -486,7 +1415,7 @@ void initializeTestVariables(int argc, char **argv)
 
     if (argc > 1)
     {
-        strncpy(fileName, argv[1], FILE_NAME_LENGTH);
+        strncpy(fileName, argv[1], FILE_NAME_LENGTH - 1);
         loadTest();
     }
     else
@@ -526,6 +1455,7 @@ void initializeTestVariables(int argc, char **argv)
         } while (!ctrlDone(buffer));
     }
     setupMode = FALSE;
+    packBlockedSegments();
     cursor[ROW] = cursor[COL] = -1; /* move cursor off of grid */
     CLEAR
     controlEnemyRobot();
@@ -590,238 +1520,731 @@ void deallocateMemory(void)
     return;
 }
 
-/*}}}*/
-/*{{{ SENSOR FUNCTIONS */
-
-/* calls the appropriate sensor function in direction dir, one or two segments away */
-Bool sense(Direction dir, short oneOrTwo)
+#ifdef PERSIST_MAP
+/* loads the map saved by the last run as a prior: every saved Segment with at least MAP_MIN_CONFIDENCE is known from
+   the start, but with less evidence than it was saved with (and with SCHEDULED_SENSE, it is not trusted until the
+   sensors agree with it) -- a map saved for a different grid, or a corrupt one, is ignored */
+void loadMap(void)
 {
-    if (oneOrTwo == 1)
-        switch (dir)
-        {
-            case FRONT: return front_s(); break;
-            case  LEFT: return  left_s(); break;
-            case RIGHT: return right_s(); break;
-#ifdef REAR_FACING_RANGE_SENSORS
-            case  BACK: return  back_s(); break;
+    int k;                      /* LCV */
+    Segment saved;
+    unsigned char confidence;
+#ifdef SMART_SENSE
+    SegmentInfo *info;
 #endif
-            default:    ERROR("Misuse of function sense\n") break;
-        }
-#ifdef LONG_RANGE_SENSORS
-    else if (oneOrTwo == 2)
-        switch (dir)
+
+    if (!readMapImage())
+        return;
+    if (mapImage[0] != 'G' || mapImage[1] != 'B' || mapImage[2] != MAP_VERSION || mapImage[3] != NUM_ROWS
+        || mapImage[4] != NUM_COLS || mapImage[MAP_BYTES - 1] != mapChecksum())
+    {
+        ERROR("Ignoring the saved map: it is corrupt or was saved for a different grid\n")
+        return;
+    }
+
+    for (k = 0; k < NUM_INNER_SEGMENTS; ++k)
+    {
+        saved = (Segment)(mapImage[MAP_HEADER + k] & 3);
+        confidence = mapImage[MAP_HEADER + k] >> 2 & MAP_MAX_CONFIDENCE;
+        if (saved == IDK || confidence < MAP_MIN_CONFIDENCE)
+            continue;
+        *innerSegment(k) = saved;
+#ifdef SMART_SENSE
+        info = segInfo(innerSegment(k));
+        info->evidence = (signed char)(confidence / 2 ? confidence / 2 : 1);
+        if (saved == UNBLOCKED)
         {
-            case FRONT: return front2_s(); break;
-            case  LEFT: return  left2_s(); break;
-            case RIGHT: return right2_s(); break;
-#ifdef REAR_FACING_RANGE_SENSORS
-            case  BACK: return  back2_s(); break;
-#endif
-            default:    ERROR("Misuse of function sense\n") break;
+            info->evidence = -info->evidence;
+            info->flags |= SEEN_OPEN;
         }
 #endif
-    else
-        ERROR("Misuse of function sense\n")
+    }
 
-    return TRUE; /* dummy value */
+    return;
 }
 
-/* call sensor functions to see if segments are blocked or not */
-void checkForBlocks(void)
+/* saves the map for the next run -- a block that was once UNBLOCKED is probably the enemy robot, so it is saved as
+   UNBLOCKED (with no confidence) instead */
+void saveMap(void)
 {
-    int i, dir;
-
-    /* define aliases for adjacent segments */
-    Segment *segPtr[NUM_DIRECTIONS];
-    #ifdef LONG_RANGE_SENSORS
-        Segment *segPtr2[NUM_DIRECTIONS];
-    #endif
-    segPtr[UP]    = current[ROW] == 0            ? NULL : &(horizSeg[current[ROW]][current[COL]]);
-    segPtr[DOWN]  = current[ROW] == NUM_ROWS - 1 ? NULL : &(horizSeg[current[ROW] + 1][current[COL]]);
-    segPtr[LEFT]  = current[COL] == 0            ? NULL : &(vertSeg[current[ROW]][current[COL]]);
-    segPtr[RIGHT] = current[COL] == NUM_COLS - 1 ? NULL : &(vertSeg[current[ROW]][current[COL] + 1]);
-    #ifdef LONG_RANGE_SENSORS
-        segPtr2[UP]    = current[ROW] < 2            ? NULL : &(horizSeg[current[ROW] - 1][current[COL]]);
-        segPtr2[DOWN]  = current[ROW] > NUM_ROWS - 3 ? NULL : &(horizSeg[current[ROW] + 2][current[COL]]);
-        segPtr2[LEFT]  = current[COL] < 2            ? NULL : &(vertSeg[current[ROW]][current[COL] - 1]);
-        segPtr2[RIGHT] = current[COL] > NUM_COLS - 3 ? NULL : &(vertSeg[current[ROW]][current[COL] + 2]);
-    #endif
-    for (i = 0; i < NUM_DIRECTIONS; ++i)
+    int k;                      /* LCV */
+    Segment *seg;
+    unsigned char confidence;
+
+    mapImage[0] = 'G';
+    mapImage[1] = 'B';
+    mapImage[2] = MAP_VERSION;
+    mapImage[3] = NUM_ROWS;
+    mapImage[4] = NUM_COLS;
+    for (k = 0; k < NUM_INNER_SEGMENTS; ++k)
     {
-        dir = (direction + i) % NUM_DIRECTIONS;
-    #ifndef REAR_FACING_RANGE_SENSORS
-        if (i != BACK)
-    #endif
+        seg = innerSegment(k);
+#ifdef SMART_SENSE
+        if (segSuspect(seg))
         {
-            if (segPtr[dir])
-                *segPtr[dir] = sense((Direction)i, 1) ? BLOCKED : UNBLOCKED;
-            #ifdef LONG_RANGE_SENSORS
-            if (segPtr2[dir] && segPtr[dir] && *segPtr[dir] == UNBLOCKED)
-                *segPtr2[dir] = (sense((Direction)i, 2) ? BLOCKED : UNBLOCKED);
-            #endif
+            mapImage[MAP_HEADER + k] = UNBLOCKED;
+            continue;
         }
+        confidence = segConfidence(seg);
+#else
+        confidence = *seg == IDK ? 0 : MAP_MAX_CONFIDENCE;    /* no estimate: trusted as last sensed */
+#endif
+        if (confidence > MAP_MAX_CONFIDENCE)
+            confidence = MAP_MAX_CONFIDENCE;
+        mapImage[MAP_HEADER + k] = (unsigned char)(*seg | confidence << 2);
     }
+    mapImage[MAP_BYTES - 1] = mapChecksum();
+
+    if (!writeMapImage())
+        ERROR("Failed to save the map\n")
 
     return;
 }
 
-/* TO SENSE BLOCKS: TRUE -- block is sensed in adjacent segment */
-Bool left_s(void)   /* for blocks to the left */
+/* returns the sum of every byte of mapImage but the checksum (mod 256) */
+unsigned char mapChecksum(void)
 {
-#ifdef VIRTUAL_BOT
-    return (blockedSegRel(LEFT) == BLOCKED || enemyPresenceRel(LEFT)) ? TRUE : FALSE;
-#else
-    /* LL: code goes here for sensing segment to the left */
-    return TRUE; /* dummy code; LL: remove this line when finished! */
-#endif
-}
+    int i;
+    unsigned char sum = 0;
 
-Bool right_s(void)  /* for blocks to the right */
-{
-#ifdef VIRTUAL_BOT
-    return (blockedSegRel(RIGHT) == BLOCKED || enemyPresenceRel(RIGHT)) ? TRUE : FALSE;
-#else
-    /* LL: code goes here for sensing segment to the right */
-    return TRUE; /* dummy code; LL: remove this line when finished! */
-#endif
+    for (i = 0; i < MAP_BYTES - 1; ++i)
+        sum += mapImage[i];
+
+    return sum;
 }
 
-Bool front_s(void)  /* for blocks to the front */
+/* reads mapImage from where the last run saved it -- returns FALSE if nothing has been saved yet */
+Bool readMapImage(void)
 {
 #ifdef VIRTUAL_BOT
-    return (blockedSegRel(FRONT) == BLOCKED || enemyPresenceRel(FRONT) == TRUE) ? TRUE : FALSE;
+    FILE *mapFile = fopen(MAP_FILE, "rb");
+    Bool ok;
+
+    if (!mapFile)
+        return FALSE;
+    ok = fread(mapImage, 1, MAP_BYTES, mapFile) == MAP_BYTES ? TRUE : FALSE;
+    fclose(mapFile);
+
+    return ok;
 #else
-    /* LL: code goes here for sensing segment to the front */
-    return TRUE; /* dummy code; LL: remove this line when finished! */
+    /* LL: eeprom_read_block(mapImage, (const void *)MAP_EEPROM_ADDR, MAP_BYTES) (from <avr/eeprom.h>) goes here --
+     *     a blank EEPROM reads as 0xFF, which fails the header check in loadMap */
+    return FALSE; /* dummy code; LL: remove this line when finished! */
 #endif
 }
 
-#ifdef REAR_FACING_RANGE_SENSORS
-Bool back_s(void)   /* for blocks to the front */
+/* writes mapImage to where the next run loads it from -- returns FALSE if it failed */
+Bool writeMapImage(void)
 {
 #ifdef VIRTUAL_BOT
-    return (blockedSegRel(BACK) == BLOCKED || enemyPresenceRel(BACK)) ? TRUE : FALSE;
+    FILE *mapFile = fopen(MAP_FILE, "wb");
+    Bool ok;
+
+    if (!mapFile)
+        return FALSE;
+    ok = fwrite(mapImage, 1, MAP_BYTES, mapFile) == MAP_BYTES ? TRUE : FALSE;
+    if (fclose(mapFile))
+        ok = FALSE;
+
+    return ok;
 #else
-    /* LL: code goes here for sensing segment to the back */
-    return TRUE; /* dummy code; LL: remove this line when finished! */
+    /* LL: eeprom_update_block(mapImage, (void *)MAP_EEPROM_ADDR, MAP_BYTES) (from <avr/eeprom.h>) goes here -- it only
+     *     writes the bytes that changed, which spares the EEPROM */
+    return TRUE;
 #endif
 }
 #endif
 
-#ifdef LONG_RANGE_SENSORS
-    /* TO SENSE BLOCKS: TRUE -- block is sensed in segment two to the left */
-    Bool left2_s(void)     /* for blocks to the left */
-    {
-    #ifdef VIRTUAL_BOT
-        return (blockedSegRel2(LEFT) == BLOCKED || enemyPresenceRel2(LEFT)) ? TRUE : FALSE;
-    #else
-        /* LL: code goes here for sensing two segments to the left */
-        return TRUE; /* dummy code; LL: remove this line when finished! */
-    #endif
+/*}}}*/
+/*{{{ SENSOR FUNCTIONS */
+
+/* every distance sensor on the robot */
+const SensorDescriptor sensors[NUM_SENSORS] =
+{
+    /*  dir,  range,        read,            enabled */
+    {  FRONT, SENSOR_RANGE, readRangeSensor, TRUE                 },
+    {  LEFT,  SENSOR_RANGE, readRangeSensor, TRUE                 },
+    {  RIGHT, SENSOR_RANGE, readRangeSensor, TRUE                 },
+    {  BACK,  SENSOR_RANGE, readRangeSensor, REAR_SENSORS_ENABLED }
+};
+
+/* call sensor functions to see if segments are blocked or not -- this is the sense step that follows every motion, so it
+   also counts one move of time: Segment readings get one call older, old blocks decay, and the enemy robot has had one
+   move since the last call */
+void checkForBlocks(void)
+{
+    PROFILE_BEGIN(PROF_SENSE);
+    segmentsChanged = FALSE;
+#ifdef SMART_SENSE
+    segmentsOpened = FALSE;
+#endif
+#ifdef SEGMENT_INFO
+    ++senseClock;
+#endif
+#ifdef SMART_SENSE
+    if (senseClock % OCC_DECAY_PERIOD == 0)
+        decayOccupancy();
+#endif
+#ifdef TRACK_ENEMY
+    predictEnemy(enemyBelief);      /* the enemy robot has had one move since the last call */
+#endif
+    senseSegments();
+    PROFILE_END(PROF_SENSE);
+
+    return;
+}
+
+/* reads the sensors and records what they see, without counting any time (checkForBlocks does that) -- called on its own
+   to take a second look at a Segment right before driving across it, which is not a move of its own */
+void senseSegments(void)
+{
+    int i, k;
+    int node;                       /* node the sensor ray is in (see Grid Tables) */
+    Direction dir;                  /* absolute Direction of sensor */
+    Bool sampled[NUM_SENSORS];      /* whether or not each sensor was read */
+    short hit[NUM_SENSORS];         /* readings: distance to the first block sensed by each sensor, 0 if none */
+    Segment *seg;
+#ifdef ASYNC_SENSE
+    Bool taken = sampling && takeNewestSample(hit); /* TRUE if hit already holds readings of the current pose */
+#endif
+
+    /* (1) issue the reads for all enabled sensors back-to-back, before touching the robot's memory, so that
+           the hardware can overlap the conversions instead of reading sensors strictly one at a time */
+    for (i = 0; i < NUM_SENSORS; ++i)
+    {
+        dir = relToAbs(direction, sensors[i].dir);
+        sampled[i] = sensors[i].enabled && nodeSeg(nodeIndex(current[ROW], current[COL]), dir) ? TRUE : FALSE;
+#ifdef SCHEDULED_SENSE
+        if (sampled[i])
+            sampled[i] = sensorNeeded(&sensors[i]);
+#endif
+#ifdef ASYNC_SENSE
+        if (sampled[i] && !taken)
+#else
+        if (sampled[i])
+#endif
+            hit[i] = (*sensors[i].read)(sensors[i].dir, sensors[i].range);
     }
 
-    Bool right2_s(void)    /* for blocks to the right */
+    /* (2) record the readings -- every segment in front of the first block sensed is UNBLOCKED, the first block is
+           BLOCKED, and nothing past the first block is recorded */
+    for (i = 0; i < NUM_SENSORS; ++i)
     {
-    #ifdef VIRTUAL_BOT
-        return (blockedSegRel2(RIGHT) == BLOCKED || enemyPresenceRel2(RIGHT)) ? TRUE : FALSE;
-    #else
-        /* LL: code goes here for sensing two segments to the right */
-        return TRUE; /* dummy code; LL: remove this line when finished! */
-    #endif
+        if (!sampled[i])
+            continue;
+        dir = relToAbs(direction, sensors[i].dir);
+        /* a Segment off the border always has a node behind it, so the ray never walks off the grid */
+        for (k = 0, node = nodeIndex(current[ROW], current[COL]); k < sensors[i].range && (seg = nodeSeg(node, dir));
+             ++k, node = nodeNext(node, dir))
+        {
+            if (k + 1 == hit[i])
+            {
+                recordSegment(seg, BLOCKED);
+                break;
+            }
+            recordSegment(seg, UNBLOCKED);
+        }
+#ifdef TRACK_ENEMY
+        observeEnemyRay(dir, hit[i], sensors[i].range);
+#endif
     }
+#ifdef TRACK_ENEMY
+    updateEnemyForecast();
+#endif
+
+    return;
+}
+
+/* records a sensor reading of a Segment in the robot's memory -- sets segmentsChanged if the reading is news (with
+   SMART_SENSE, only new blocks are news, since a Segment opening up never invalidates a path home; an unknown Segment
+   found UNBLOCKED sets segmentsOpened instead, since the path home may be faster through it) */
+void recordSegment(Segment *seg, Segment reading)
+{
+#ifdef SEGMENT_INFO
+    SegmentInfo *info = segInfo(seg);
+#endif
+
+#ifdef SCHEDULED_SENSE
+    if (*seg != reading)
+        info->agree = 1;
+    else if (info->agree < 255)
+        ++info->agree;
+    info->stamp = senseClock;
+#endif
 
-    Bool front2_s(void)   /* for blocks to the front */
+#ifdef SMART_SENSE
+    /* combine the reading with earlier ones: a block seen once on a Segment that was UNBLOCKED many times is weak
+       evidence (and decays quickly), while a block seen many times is strong evidence */
+    if (reading == BLOCKED)
+        info->evidence = info->evidence + OCC_HIT > OCC_MAX ? OCC_MAX : info->evidence + OCC_HIT;
+    else
     {
-    #ifdef VIRTUAL_BOT
-        return (blockedSegRel2(FRONT) == BLOCKED || enemyPresenceRel2(FRONT)) ? TRUE : FALSE;
-    #else
-        /* LL: code goes here for sensing two segments to the front */
-        return TRUE; /* dummy code; LL: remove this line when finished! */
-    #endif
+        info->evidence = info->evidence - OCC_MISS < -OCC_MAX ? -OCC_MAX : info->evidence - OCC_MISS;
+        info->flags |= SEEN_OPEN;
     }
+    info->flags &= ~REOPENED;
 
-    #ifdef REAR_FACING_RANGE_SENSORS
-    Bool back2_s(void)   /* for blocks to the front */
+    if (*seg != reading)
     {
-    #ifdef VIRTUAL_BOT
-        return (blockedSegRel2(BACK) == BLOCKED || enemyPresenceRel2(BACK)) ? TRUE : FALSE;
-    #else
-        /* LL: code goes here for sensing two segments to the back */
-        return TRUE; /* dummy code; LL: remove this line when finished! */
-    #endif
+        if (reading == BLOCKED)
+            segmentsChanged = TRUE;
+        else if (*seg == IDK)
+            segmentsOpened = TRUE;
+        *seg = reading;
+    }
+#else
+    if (*seg != reading)
+    {
+        *seg = reading;
+        segmentsChanged = TRUE;
     }
-    #endif
 #endif
 
-/*}}}*/
-/*{{{ ACTUATOR FUNCTIONS */
+    return;
+}
 
-/* turn robot to face specified absolute Direction */
-void turnAbs(Direction dirToFace)
+#ifdef SEGMENT_INFO
+/* returns the knowledge state of a Segment in horizSeg or vertSeg */
+SegmentInfo *segInfo(Segment *seg)
 {
-    /* want to face up */
-    if (dirToFace == UP)
+    if (seg >= &horizSeg[0][0] && seg < &horizSeg[0][0] + NUM_HORIZ_SEG_ROWS * NUM_HORIZ_SEG_COLS)
+        return &horizSegInfo[0][0] + (seg - &horizSeg[0][0]);
+    else
+        return &vertSegInfo[0][0] + (seg - &vertSeg[0][0]);
+}
+#endif
+
+#ifdef SMART_SENSE
+/* decays the evidence of every BLOCKED Segment that was once sensed as UNBLOCKED by one unit, and reopens it (marks it
+   UNBLOCKED) once there is no evidence of a block left -- blocks that were never seen open are stationary obstacles and
+   never decay. Reopening a Segment does not set segmentsChanged, so a ghost of the enemy robot disappearing from memory
+   never makes the robot recalculate its path home. */
+void decayOccupancy(void)
+{
+    Segment *seg;
+    SegmentInfo *info;
+
+    for (seg = &horizSeg[0][0]; seg < &horizSeg[0][0] + NUM_HORIZ_SEG_ROWS * NUM_HORIZ_SEG_COLS; ++seg)
     {
-        if (direction == DOWN)
-            turn180();
-        else if (direction == LEFT)
-            turnRight();
-        else if (direction == RIGHT)
-            turnLeft();
-        /* else (direction == UP) ---> no need to turn */
+        info = segInfo(seg);
+        if (*seg == BLOCKED && (info->flags & SEEN_OPEN) && --info->evidence <= 0)
+        {
+            *seg = UNBLOCKED;
+            info->flags |= REOPENED;
+        }
     }
-    /* want to face down */
-    else if (dirToFace == DOWN)
+    for (seg = &vertSeg[0][0]; seg < &vertSeg[0][0] + NUM_VERT_SEG_ROWS * NUM_VERT_SEG_COLS; ++seg)
     {
-        if (direction == UP)
-            turn180();
-        else if (direction == LEFT)
-            turnLeft();
-        else if (direction == RIGHT)
-            turnRight();
-        /* else (direction == DOWN) ---> no need to turn */
+        info = segInfo(seg);
+        if (*seg == BLOCKED && (info->flags & SEEN_OPEN) && --info->evidence <= 0)
+        {
+            *seg = UNBLOCKED;
+            info->flags |= REOPENED;
+        }
     }
-    /* want to face left */
-    else if (dirToFace == LEFT)
+
+    return;
+}
+
+/* returns how confident the robot is in its memory of a Segment, from 0 (no idea) to OCC_MAX (sensed the same way
+   many times) -- Segments reopened by decay have not been confirmed and get 0 */
+unsigned char segConfidence(Segment *seg)
+{
+    SegmentInfo *info = segInfo(seg);
+
+    if (*seg == IDK || (info->flags & REOPENED))
+        return 0;
+    else
+        return info->evidence < 0 ? -info->evidence : info->evidence;
+}
+
+/* returns TRUE if a BLOCKED Segment was once sensed as UNBLOCKED -- i.e., the block is probably the enemy robot */
+Bool segSuspect(Segment *seg)
+{
+    return *seg == BLOCKED && (segInfo(seg)->flags & SEEN_OPEN) ? TRUE : FALSE;
+}
+#endif
+
+#ifdef SCHEDULED_SENSE
+/* decides whether a sensor is worth reading: the relative FRONT sensor is always read since the robot is about to drive
+   through the segment in front of it, and any other sensor is read if one of the segments it can see (up to the first
+   remembered block) is unknown, has not been sensed the same way SENSE_TRUST times in a row, or was last read
+   SENSE_MAX_AGE or more calls to checkForBlocks() ago */
+Bool sensorNeeded(const SensorDescriptor *sensor)
+{
+    Direction dir = relToAbs(direction, sensor->dir);
+    Segment *seg;
+    SegmentInfo *info;
+    int k, node;
+
+    if (sensor->dir == FRONT)
+        return TRUE;
+    for (k = 0, node = nodeIndex(current[ROW], current[COL]); k < sensor->range && (seg = nodeSeg(node, dir));
+         ++k, node = nodeNext(node, dir))
     {
-        if (direction == UP)
-            turnLeft();
-        else if (direction == DOWN)
-            turnRight();
-        else if (direction == RIGHT)
-            turn180();
-        /* else (direction == LEFT) ---> no need to turn */
+        info = segInfo(seg);
+        if (*seg == IDK || info->agree < SENSE_TRUST || (unsigned char)(senseClock - info->stamp) >= SENSE_MAX_AGE)
+            return TRUE;
+        if (*seg == BLOCKED) /* sensor cannot see past a block */
+            break;
+    }
+    return FALSE;
+}
+#endif
+
+/* TO SENSE BLOCKS: returns the distance (in segments, 1 to range) to the first block sensed in relative Direction relDir,
+   or 0 if nothing is sensed within range segments */
+short readRangeSensor(Direction relDir, short range)
+{
+#ifdef VIRTUAL_BOT
+    return virtualRayCast(current, enemy, relToAbs(direction, relDir), range);
+#else
+    /* LL: code goes here for reading the sensor facing relative Direction relDir (FRONT, LEFT, RIGHT, or BACK) and
+     *     converting the distance it measures into a number of segments (1 for the adjacent segment), or 0 if it sees
+     *     farther than 'range' segments. checkForBlocks calls this for every enabled sensor back-to-back, so it is safe
+     *     to start a conversion here and collect the result of the previous one. */
+    return 1; /* dummy code; LL: remove this line when finished! */
+#endif
+}
+
+#ifdef ASYNC_SENSE
+#ifdef VIRTUAL_BOT
+pthread_t samplerThread;    /* producer thread -- stands in for the sensor timer interrupt */
+
+/* runs the producer every SAMPLE_PERIOD_NS until stopSampling() */
+void *samplerMain(void *dummy)
+{
+    struct timespec period;
+    Bool running;
+
+    period.tv_sec = 0;
+    period.tv_nsec = SAMPLE_PERIOD_NS;
+    while (TRUE)
+    {
+        pthread_mutex_lock(&poseLock);
+        running = sampling;
+        pthread_mutex_unlock(&poseLock);
+        if (!running)
+            break;
+        sampleSensors();
+        nanosleep(&period, NULL);
     }
-    /* want to face right */
-    else /* dirToFace == RIGHT */
+    return NULL;
+}
+
+/* marks every sample taken so far as stale, and hands the producer the pose (and the enemy robot's position) the
+   virtual sensors see from now on */
+void poseChanged(void)
+{
+    pthread_mutex_lock(&poseLock);
+    poseSnapshot.at[ROW] = current[ROW];
+    poseSnapshot.at[COL] = current[COL];
+    poseSnapshot.heading = direction;
+    poseSnapshot.enemyAt[ROW] = enemy[ROW];
+    poseSnapshot.enemyAt[COL] = enemy[COL];
+    ++poseEpoch;
+    pthread_mutex_unlock(&poseLock);
+
+    return;
+}
+#endif
+
+/* starts sampling the sensors in the background */
+void startSampling(void)
+{
+    sampling = TRUE;
+#ifdef VIRTUAL_BOT
+    poseChanged();  /* the producer's first pose */
+    if (pthread_create(&samplerThread, NULL, samplerMain, NULL))
     {
-        if (direction == UP)
-            turnRight();
-        else if (direction == DOWN)
-            turnLeft();
-        else if (direction == LEFT)
-            turn180();
-        /* else (direction == RIGHT) ---> no need to turn */
+        ERROR("Failed to start the sampler thread -- reading the sensors directly\n")
+        sampling = FALSE;
+    }
+#else
+    /* LL: set up a timer interrupt whose ISR calls sampleSensors() (e.g. ISR(TIMER1_COMPA_vect) { sampleSensors(); })
+     *     and enable it here -- the ISR must not fire again before sampleSensors() returns */
+#endif
+
+    return;
+}
+
+/* stops sampling the sensors in the background */
+void stopSampling(void)
+{
+    if (!sampling)
+        return;
+#ifdef VIRTUAL_BOT
+    pthread_mutex_lock(&poseLock);
+    sampling = FALSE;
+    pthread_mutex_unlock(&poseLock);
+    pthread_join(samplerThread, NULL);
+#else
+    sampling = FALSE;
+    /* LL: disable the sensor timer interrupt here */
+#endif
+
+    return;
+}
+
+/* PRODUCER: reads every enabled sensor and pushes the readings onto sampleRing, tagged with the time and poseEpoch --
+   nothing is pushed if the robot moved while the sensors were being read (the readings would be a mix of two poses),
+   if the readings are the same as the last ones pushed in the same pose, or if sampleRing is full. In the virtual grid
+   the sensors are read from poseSnapshot, so all the readings of a sample are of the pose of its epoch. */
+void sampleSensors(void)
+{
+    static SensorSample last;       /* last sample pushed */
+    static Bool pushedAny = FALSE;  /* FALSE until the first sample is pushed */
+    SensorSample s;
+    unsigned char head = sampleHead;
+    Bool news;
+    int i;
+#ifdef VIRTUAL_BOT
+    PoseSnapshot pose;              /* pose of s.epoch */
+
+    pthread_mutex_lock(&poseLock);
+    pose = poseSnapshot;
+    s.epoch = poseEpoch;
+    pthread_mutex_unlock(&poseLock);
+    s.time = sampleClock++;
+    for (i = 0; i < NUM_SENSORS; ++i)
+        s.hit[i] = sensors[i].enabled ? virtualRayCast(pose.at, pose.enemyAt, relToAbs(pose.heading, sensors[i].dir),
+                                                       sensors[i].range) : 0;
+#else
+    s.epoch = poseEpoch;
+    s.time = sampleClock++;
+    MEMORY_BARRIER()
+    for (i = 0; i < NUM_SENSORS; ++i)
+        s.hit[i] = sensors[i].enabled ? (*sensors[i].read)(sensors[i].dir, sensors[i].range) : 0;
+    MEMORY_BARRIER()
+    if (poseEpoch != s.epoch)
+        return;
+#endif
+
+    news = !pushedAny || s.epoch != last.epoch;
+    for (i = 0; i < NUM_SENSORS && !news; ++i)
+        news = s.hit[i] != last.hit[i];
+    if (!news || (unsigned char)(head - sampleTail) == SAMPLE_RING_SIZE)
+        return;
+
+    sampleRing[head % SAMPLE_RING_SIZE] = s;
+    MEMORY_BARRIER()                /* the sample must be in place before the consumer can see it */
+    sampleHead = head + 1;
+    last = s;
+    pushedAny = TRUE;
+
+    return;
+}
+
+/* CONSUMER: pops every sample off sampleRing, and copies the readings of the newest one taken in the current pose into
+   hit -- returns FALSE (leaving hit alone) if there is none. The newest readings are kept for the next call, since the
+   producer does not push the same readings twice. */
+Bool takeNewestSample(short hit[NUM_SENSORS])
+{
+    static SensorSample newest;     /* newest sample taken so far */
+    static Bool haveNewest = FALSE; /* FALSE if newest is unset or has gone stale */
+    unsigned char tail = sampleTail;
+    unsigned char head = sampleHead;
+    int i;
+
+    MEMORY_BARRIER()                /* the samples can only be read after sampleHead is */
+    for (; tail != head; ++tail)
+        if (sampleRing[tail % SAMPLE_RING_SIZE].epoch == poseEpoch)
+        {
+            newest = sampleRing[tail % SAMPLE_RING_SIZE];
+            haveNewest = TRUE;
+        }
+    MEMORY_BARRIER()                /* the samples must be read before their slots are handed back */
+    sampleTail = tail;
+
+    if (!haveNewest || newest.epoch != poseEpoch)
+    {
+        haveNewest = FALSE;         /* poseEpoch wraps -- a stale sample must never match it again */
+        return FALSE;
+    }
+    for (i = 0; i < NUM_SENSORS; ++i)
+        hit[i] = newest.hit[i];
+    return TRUE;
+}
+#endif
+
+/*}}}*/
+/*{{{ ENEMY TRACKING FUNCTIONS */
+#ifdef TRACK_ENEMY
+
+/* the enemy robot always starts in the far corner (on the flag), so all of the belief starts there */
+void initializeEnemyTracker(void)
+{
+    int i, j;   /* LCV's */
+
+    for (i = 0; i < NUM_ROWS; ++i)
+        for (j = 0; j < NUM_COLS; ++j)
+            enemyBelief[i][j] = 0;
+    enemyBelief[NUM_ROWS - 1][NUM_COLS - 1] = ENEMY_SCALE;
+    updateEnemyForecast();
+    avoidEnemy = TRUE;
+
+    return;
+}
+
+/* moves a belief forward by one move of the enemy robot: in each node, 1 of every ENEMY_STAY_SHARE parts of the belief
+   stays put and the rest is split evenly among the neighbouring nodes that the enemy robot can drive to -- every
+   neighbour except the ones behind a stationary obstacle (a BLOCKED Segment that was never UNBLOCKED). The total
+   belief does not change. */
+void predictEnemy(unsigned short belief[NUM_ROWS][NUM_COLS])
+{
+    unsigned short before[NUM_ROWS][NUM_COLS];  /* belief before the move */
+    Bool open[NUM_DIRECTIONS];                  /* whether the enemy robot can leave a node in each absolute Direction */
+    int numOpen;
+    unsigned short share;                       /* belief moving into each open neighbour */
+    Segment *seg;
+    Direction dir;
+    int i, j;                                   /* LCV's */
+
+    for (i = 0; i < NUM_ROWS; ++i)
+        for (j = 0; j < NUM_COLS; ++j)
+        {
+            before[i][j] = belief[i][j];
+            belief[i][j] = 0;
+        }
+
+    for (i = 0; i < NUM_ROWS; ++i)
+        for (j = 0; j < NUM_COLS; ++j)
+        {
+            if (!before[i][j])
+                continue;
+            numOpen = 0;
+            for (dir = UP; dir < NUM_DIRECTIONS; ++dir)
+            {
+                seg = segPtrAt(i, j, dir);
+                open[dir] = seg && (*seg != BLOCKED || segSuspect(seg)) ? TRUE : FALSE;
+                numOpen += open[dir];
+            }
+            share = numOpen ? (before[i][j] - before[i][j] / ENEMY_STAY_SHARE) / numOpen : 0;
+            for (dir = UP; dir < NUM_DIRECTIONS; ++dir)
+                if (open[dir])
+                    belief[i + rowDelta[dir]][j + colDelta[dir]] += share;
+            belief[i][j] += before[i][j] - share * numOpen;
+        }
+
+    return;
+}
+
+/* folds the reading of a sensor facing absolute Direction absDir into enemyBelief (call after the reading is recorded):
+   the enemy robot is not in any node the sensor saw through, and it is more likely to be in the node behind the block the
+   sensor hit if the block was sensed for the first time, or much more likely if the block was once UNBLOCKED */
+void observeEnemyRay(Direction absDir, short hit, short range)
+{
+    int row = current[ROW], col = current[COL];
+    int node = nodeIndex(row, col);
+    Segment *seg;
+    int k;
+
+    for (k = 0; k < range && (seg = nodeSeg(node, absDir)); ++k)
+    {
+        node = nodeNext(node, absDir);
+        row += rowDelta[absDir];
+        col += colDelta[absDir];
+        if (k + 1 == hit)
+        {
+            if (segSuspect(seg))
+                enemyBelief[row][col] = (enemyBelief[row][col] + ENEMY_FLOOR) * ENEMY_HIT_GAIN;
+            else if (segConfidence(seg) <= OCC_HIT)
+                enemyBelief[row][col] = (enemyBelief[row][col] + ENEMY_FLOOR) * ENEMY_NEW_HIT_GAIN;
+            break;
+        }
+        enemyBelief[row][col] = 0;
+    }
+
+    return;
+}
+
+/* normalizes enemyBelief back to ENEMY_SCALE (the enemy robot is never in the robot's own node), starting over from an
+   even spread if the readings ruled out every node, and recalculates enemyForecast from it */
+void updateEnemyForecast(void)
+{
+    unsigned short step[NUM_ROWS][NUM_COLS];    /* belief t moves from now */
+    unsigned long total = 0;
+    int i, j, t;                                /* LCV's */
+
+    enemyBelief[current[ROW]][current[COL]] = 0;
+    for (i = 0; i < NUM_ROWS; ++i)
+        for (j = 0; j < NUM_COLS; ++j)
+            total += enemyBelief[i][j];
+
+    for (i = 0; i < NUM_ROWS; ++i)
+        for (j = 0; j < NUM_COLS; ++j)
+        {
+            if (!total)
+                enemyBelief[i][j] = ENEMY_SCALE / (NUM_NODES - 1);
+            else
+                enemyBelief[i][j] = (unsigned short)(enemyBelief[i][j] * (unsigned long)ENEMY_SCALE / total);
+            step[i][j] = enemyBelief[i][j];
+        }
+    if (!total)
+        enemyBelief[current[ROW]][current[COL]] = step[current[ROW]][current[COL]] = 0;
+
+    for (t = 0; t <= ENEMY_HORIZON; ++t)
+    {
+        if (t > 0)
+            predictEnemy(step);
+        for (i = 0; i < NUM_ROWS; ++i)
+            for (j = 0; j < NUM_COLS; ++j)
+                enemyForecast[t][i][j] = (unsigned char)(step[i][j] * 255UL / ENEMY_SCALE);
     }
 
-  return;
+    return;
+}
+
+/* returns the chance (out of 255) that the enemy robot is in node (row, col) after 'moves' more moves of the robot --
+   moves past ENEMY_HORIZON get the forecast for ENEMY_HORIZON */
+unsigned char enemyChance(int row, int col, int moves)
+{
+    return enemyForecast[moves < ENEMY_HORIZON ? moves : ENEMY_HORIZON][row][col];
+}
+
+/* returns the node the enemy robot is most likely to be in */
+void enemyBestGuess(int guess[2])
+{
+    int i, j;   /* LCV's */
+
+    guess[ROW] = guess[COL] = 0;
+    for (i = 0; i < NUM_ROWS; ++i)
+        for (j = 0; j < NUM_COLS; ++j)
+            if (enemyBelief[i][j] > enemyBelief[guess[ROW]][guess[COL]])
+            {
+                guess[ROW] = i;
+                guess[COL] = j;
+            }
+
+    return;
+}
+
+#endif
+/*}}}*/
+/*{{{ ACTUATOR FUNCTIONS */
+
+/* turn robot to face specified absolute Direction */
+void turnAbs(Direction dirToFace)
+{
+    Direction rel = absToRel(direction, dirToFace);
+
+    if (rel != FRONT) /* else no need to turn */
+        (*turnTo[rel])();
+
+    return;
 }
 
 /* turns robot 90 degrees to relative LEFT */
 void turnLeft(void)
 {
+    stopRolling();
 #if !defined(VIRTUAL_BOT) && defined(ACTUATORS_ON)
     /* LL: stepper motor code for turning robot 90 degrees to the left goes here */
 #endif
 
-    if (direction == UP)
-        direction = LEFT;
-    else if (direction == DOWN)
-        direction = RIGHT;
-    else if (direction == LEFT)
-        direction = DOWN;
-    else /* direction == RIGHT */
-        direction = UP;
+    direction = relToAbs(direction, LEFT);
+    ++motionCount;
+    poseChanged();
 
     return;
 }
@@ -829,18 +2252,14 @@ void turnLeft(void)
 /* turns robot 90 degrees to relative RIGHT */
 void turnRight(void)
 {
+    stopRolling();
 #if !defined(VIRTUAL_BOT) && defined(ACTUATORS_ON)
     /* LL: stepper motor code for turning robot 90 degrees to the right goes here */
 #endif
 
-    if (direction == UP)
-        direction = RIGHT;
-    else if (direction == DOWN)
-        direction = LEFT;
-    else if (direction == LEFT)
-        direction = UP;
-    else /* direction == RIGHT */
-        direction = DOWN;
+    direction = relToAbs(direction, RIGHT);
+    ++motionCount;
+    poseChanged();
 
     return;
 }
@@ -848,49 +2267,60 @@ void turnRight(void)
 /* turns robot 180 degrees from it's current relative position */
 void turn180(void)
 {
+    stopRolling();
 #if !defined(VIRTUAL_BOT) && defined(ACTUATORS_ON)
     /* LL: stepper motor code for turning robot 180 degrees goes here */
 #endif
 
-    if (direction == UP)
-        direction = DOWN;
-    else if (direction == DOWN)
-        direction = UP;
-    else if (direction == LEFT)
-        direction = RIGHT;
-    else /* direction == RIGHT */
-        direction = LEFT;
+    direction = relToAbs(direction, BACK);
+    motionCount += 2;
+    poseChanged();
 
     return;
 }
 
-/* if the relative FRONT Segment is UNBLOCKED (no blocks and not on edge of grid), move forward one Node; then check for surrounding
-   blocks and update the grid and Segment arrays; then capture the flag if at flag--if capturing flag, update the global haveFlag variable */
-void moveForward(void)
+/* if the relative FRONT Segment is UNBLOCKED (no blocks and not on edge of grid), move forward one Node; then capture the
+   flag if at flag--if capturing flag, update the global haveFlag variable. The scheduler shows the move and checks for
+   surrounding blocks after it (see outputTask and senseTask). Moves in a row are one continuous motion: the robot keeps
+   rolling from one node into the next until something stops it (see stopRolling). Returns FALSE if the robot did not
+   move, so that a caller following a plan can plan again. */
+Bool moveForward(void)
 {
-    /* define aliases for adjacent segments -- used when returning home to see if status of Segments have changed */
-    Segment top, btm, lft, rgt;
-    #ifdef LONG_RANGE_SENSORS
-        Segment top2, btm2, lft2, rgt2;
-    #endif
+    Bool moved = FALSE;
+
+    PROFILE_BEGIN(PROF_MOVE);
+#ifdef SMART_SENSE
+    /* a Segment reopened by decay is only a guess -- sense it before driving through it, and stay put if it turns out to
+       be blocked after all (that is news, not a logic error) */
+    if (segPtrAbsx(direction, 0) && (segInfo(segPtrAbsx(direction, 0))->flags & REOPENED))
+    {
+        senseSegments();
+        if (segRel(FRONT) != UNBLOCKED)
+        {
+            stopRolling();
+            motionDone = TRUE;
+            PROFILE_END(PROF_MOVE);
+            return FALSE;
+        }
+    }
+#endif
 
     /* check to make sure the robot can make the movement */
     if (segRel(FRONT) == UNBLOCKED)
     {
         #if !defined(VIRTUAL_BOT) && defined(ACTUATORS_ON)
-            /* LL: stepper motor code for moving robot one space forward goes here
+            /* LL: stepper motor code for moving robot one space forward goes here -- only ramp up from a stop if not
+             *     rolling, and otherwise keep the motors running from the last space into this one
              *     CRITICAL: Robot must move entirely to next space before next lines of code execute!!! */
         #endif
+        rolling = TRUE;
 
         /* update current array */
-        if (direction == UP)
-            --current[ROW]; /* decrement row */
-        else if (direction == DOWN)
-            ++current[ROW]; /* increment row */
-        else if (direction  == LEFT)
-            --current[COL]; /* decrement column */
-        else /* direction == RIGHT */
-            ++current[COL]; /* increment column */
+        current[ROW] += rowDelta[direction];
+        current[COL] += colDelta[direction];
+        ++motionCount;
+        poseChanged();
+        moved = TRUE;
 
         #ifdef REMEMBER_VISITED_NODES
             grid[current[ROW]][current[COL]] = VISITED;
@@ -905,47 +2335,37 @@ void moveForward(void)
     }
     else
     {
+        stopRolling();
         ERROR("Logic Error: Planned to move forward, but FRONT is blocked\n")
     }
+    motionDone = TRUE;
+    PROFILE_END(PROF_MOVE);
 
-    #ifdef VIRTUAL_BOT
-        controlEnemyRobot();
-    #elif defined(DEBUG_GRID)
-        displayDebugGrid();
-    #endif
-
-    /* if robot is on its way home */
-    if (fastestPath)
-    {
-        top = horizSeg[current[ROW]][current[COL]];
-        btm = horizSeg[current[ROW] + 1][current[COL]];
-        lft = vertSeg[current[ROW]][current[COL]];
-        rgt = vertSeg[current[ROW]][current[COL] + 1];
-        #ifdef LONG_RANGE_SENSORS
-            top2 = current[ROW] < 1            ? -1 : horizSeg[current[ROW] - 1][current[COL]];
-            btm2 = current[ROW] > NUM_ROWS - 2 ? -1 : horizSeg[current[ROW] + 2][current[COL]];
-            lft2 = current[COL] < 1            ? -1 : vertSeg[current[ROW]][current[COL] - 1];
-            rgt2 = current[COL] > NUM_COLS - 2 ? -1 : vertSeg[current[ROW]][current[COL] + 2];
-        #endif
-    }
+    return moved;
+}
 
-    /* always check for blocks */
-    checkForBlocks();
+/* sits still for as long as it takes to move one node (so the enemy robot gets a move, just like after moveForward) */
+void waitOneMove(void)
+{
+    stopRolling();
+#if !defined(VIRTUAL_BOT) && defined(ACTUATORS_ON)
+    /* LL: delay for as long as moving one space forward takes goes here */
+#endif
+    motionDone = TRUE;
 
-    if (fastestPath)
+    return;
+}
+
+/* brings the robot to a stop if it is still rolling from the last move -- called before anything that cannot be done on
+   the move (turning, waiting, planning, or the end of the mission) */
+void stopRolling(void)
+{
+    if (rolling)
     {
-        if (  (top != horizSeg[current[ROW]][current[COL]]    )
-           || (btm != horizSeg[current[ROW] + 1][current[COL]])
-           || (lft != vertSeg[current[ROW]][current[COL]]     )
-           || (rgt != vertSeg[current[ROW]][current[COL] + 1] )
-        #ifdef LONG_RANGE_SENSORS
-           || (top2 >= 0 && top2 != horizSeg[current[ROW] - 1][current[COL]])
-           || (btm2 >= 0 && btm2 != horizSeg[current[ROW] + 2][current[COL]])
-           || (lft2 >= 0 && lft2 != vertSeg[current[ROW]][current[COL] - 1] )
-           || (rgt2 >= 0 && rgt2 != vertSeg[current[ROW]][current[COL] + 2] )
-        #endif
-           ) segmentsChanged = TRUE;
-        else segmentsChanged = FALSE;
+    #if !defined(VIRTUAL_BOT) && defined(ACTUATORS_ON)
+        /* LL: stepper motor code for bringing the robot to a stop goes here */
+    #endif
+        rolling = FALSE;
     }
 
     return;
@@ -954,7 +2374,9 @@ void moveForward(void)
 /* captures the flag (makes virtual robot just beep a few times) */
 void captureFlag(void)
 {
-    #ifdef VIRTUAL_BOT
+    #ifdef BENCHMARK
+        /* stays quiet -- the benchmark captures the flag hundreds of times */
+    #elif defined(VIRTUAL_BOT)
         printf("\a\a\a"); /* beep a few times */
     #elif defined(ACTUATORS_ON)
         /* LL: capture the flag code */
@@ -984,54 +2406,31 @@ Segment segAbsx(Direction absDir, int x)
         return vertSeg[current[ROW]][current[COL] + 1 + x];
 }
 
-/* returns status of adjacent segment, specified by relative Direction */
-Segment segRel(Direction relSeg)
+/* returns pointer to x away segment, specified by absolute Direction -- NULL if the segment is on (or beyond)
+   the border of the grid, since border segments are always BLOCKED */
+Segment *segPtrAbsx(Direction absDir, int x)
 {
-    Segment returnValue;
+    int node = nodeIndex(current[ROW], current[COL]);
 
-    /* currently facing absolute UP */
-    if (direction == UP)
-    {
-        returnValue = segAbs(relSeg); /* same as segAbs function */
-    }
-    /* currently facing absolute DOWN */
-    else if (direction == DOWN)
-    {
-        if (relSeg == FRONT) /* absolute DOWN */
-            returnValue = segAbs(DOWN);
-        else if (relSeg == BACK) /* absolute UP */
-            returnValue = segAbs(UP);
-        else if (relSeg == LEFT) /* absolute RIGHT */
-            returnValue = segAbs(RIGHT);
-        else /* relSeg == RIGHT ---> absolute LEFT */
-            returnValue = segAbs(LEFT);
-    }
-    /* currently facing absolute LEFT */
-    else if (direction == LEFT)
-    {
-        if (relSeg == FRONT) /* absolute LEFT */
-            returnValue = segAbs(LEFT);
-        else if (relSeg == BACK) /* absolute RIGHT */
-            returnValue = segAbs(RIGHT);
-        else if (relSeg == LEFT) /* absolute DOWN */
-            returnValue = segAbs(DOWN);
-        else /* relSeg == RIGHT ---> absolute UP */
-            returnValue = segAbs(UP);
-    }
-    /* currently facing absolute RIGHT */
-    else /* direction == RIGHT */
-    {
-        if (relSeg == FRONT) /* absolute RIGHT */
-            returnValue = segAbs(RIGHT);
-        else if (relSeg == BACK) /* absolute LEFT */
-            returnValue = segAbs(LEFT);
-        else if (relSeg == LEFT) /* absolute UP */
-            returnValue = segAbs(UP);
-        else /* relSeg == RIGHT ---> absolute DOWN */
-            returnValue = segAbs(DOWN);
-    }
+    for (; x > 0 && node != NO_NODE; --x)
+        node = nodeNext(node, absDir);
+    return node == NO_NODE ? NULL : nodeSeg(node, absDir);
+}
+
+/* returns a pointer to the k-th segment off the border of the grid: the horizontal Segments row by row, and then the
+   vertical Segments row by row */
+Segment *innerSegment(int k)
+{
+    if (k < (NUM_HORIZ_SEG_ROWS - 2) * NUM_HORIZ_SEG_COLS)
+        return &horizSeg[1 + k / NUM_HORIZ_SEG_COLS][k % NUM_HORIZ_SEG_COLS];
+    k -= (NUM_HORIZ_SEG_ROWS - 2) * NUM_HORIZ_SEG_COLS;
+    return &vertSeg[k / (NUM_VERT_SEG_COLS - 2)][1 + k % (NUM_VERT_SEG_COLS - 2)];
+}
 
-    return returnValue;
+/* returns status of adjacent segment, specified by relative Direction */
+Segment segRel(Direction relSeg)
+{
+    return segAbs(relToAbs(direction, relSeg));
 }
 
 /*}}}*/
@@ -1057,218 +2456,502 @@ Bool inRightCol_OR_OpeningBelow(void *dummy)
     return current[COL] == NUM_COLS - 1 || segAbs(DOWN) == UNBLOCKED;
 }
 
-/* moves the robot from the top-left space to the bottom-right in the grid */
+/* advances the robot from the top-left space toward the bottom-right in the grid by one state of the mission */
 void moveToFlag(void)
 {
-    int tmp;                       /* temporary storage for row and column number */
-    int troubleSpot[2] = { 0, 0 }; /* location where we are blocked to both right and bottom */
-    Bool stuck = FALSE;            /* indicates a failure of first attempt to get unstuck */
+    Bool up;    /* TRUE if the way out of a trouble spot is up rather than left */
 
-    /* while not in destination */
-    while (!(current[ROW] == NUM_ROWS - 1 && current[COL] == NUM_COLS - 1))
+    switch (mission)
     {
-        /* we can move in the desired direction */
-        if (segAbs(DOWN) == UNBLOCKED || segAbs(RIGHT) == UNBLOCKED)
-        {
-Down_Label:
+        case SEEK_DECIDE:
+            /* in destination */
+            if (current[ROW] == NUM_ROWS - 1 && current[COL] == NUM_COLS - 1)
+                mission = HOME_PLAN;
+#ifdef PLAN_TO_FLAG
+            else if (planToFlag)
+                mission = FLAG_PLAN;
+#endif
+            /* we can move in the desired direction */
+            else if (segAbs(DOWN) == UNBLOCKED || segAbs(RIGHT) == UNBLOCKED)
+                mission = SEEK_DOWN;
+            /* if we can, we need to move either UP or LEFT */
+            else if (segAbs(UP) == UNBLOCKED || segAbs(LEFT) == UNBLOCKED)
+            {
+                /* see if our current grid position is a trouble spot -- if we are back at the last one, the way out we
+                   took from it led us around in a circle (the first attempt to get unstuck failed) */
+                if (troubleSpot[ROW] == current[ROW] && troubleSpot[COL] == current[COL])
+                {
+                    stuck = !stuck;
+                }
+                else
+                {
+                    /* save our current coordinates */
+                    troubleSpot[ROW] = current[ROW];
+                    troubleSpot[COL] = current[COL];
+                    stuck = FALSE;
+                }
+
+                /* we want to move in the direction that places us more in the center of the grid */
+                /* in this case, moving up gets us closer to center (or we have no other choice) -- unless we are stuck,
+                   in which case we take the other way out of the trouble spot this time */
+                up = (NUM_ROWS - current[ROW] <= NUM_COLS - current[COL] && segAbs(UP) == UNBLOCKED)
+                     || segAbs(LEFT) == BLOCKED; /* no other choice */
+                if (stuck && segAbs(up ? LEFT : UP) == UNBLOCKED)
+                    up = !up;
+                if (up)
+                {
+                    /* move up until we can't go any further or there is an opening to the right */
+                    turnAbs(UP);
+                    moveForward();
+                    mission = SEEK_UP;
+                }
+                /* in this case, moving left gets us closer to center (or we have no other choice) */
+                else
+                {
+                    /* move left until we can't go any further or there is an opening to abs down */
+                    turnAbs(LEFT);
+                    moveForward();
+                    mission = SEEK_LEFT;
+                }
+            }
+            /* there is nothing open, so we need to sit still and read sensors until there is an opening */
+            else
+                waitOneMove();
+            break;
+
+        case SEEK_DOWN:
             /* if able, move abs down until there is a block */
             if (segAbs(DOWN) == UNBLOCKED)
             {
                 turnAbs(DOWN);
-                do moveForward(); while (segAbs(DOWN) == UNBLOCKED);
+                moveForward();
             }
-Right_Label:
+            else
+                mission = SEEK_RIGHT;
+            break;
+
+        case SEEK_RIGHT:
             /* if able, move abs right until there is a block */
             if (segAbs(RIGHT) == UNBLOCKED)
             {
                 turnAbs(RIGHT);
-                do moveForward(); while (segAbs(RIGHT) == UNBLOCKED);
-            }
-        }
-        /* if we can, we need to move either UP or LEFT */
-        else if (segAbs(UP) == UNBLOCKED || segAbs(LEFT) == UNBLOCKED)
-        {
-            /* see if our current grid position is a trouble spot */
-            /* TODO: do something with this "stuck" variable */
-            if (troubleSpot[ROW] == current[ROW] && troubleSpot[COL] == current[COL])
-            {
-                stuck = TRUE;
+                moveForward();
             }
             else
+                mission = SEEK_DECIDE;
+            break;
+
+        case SEEK_UP:
+            if (segAbs(UP) == UNBLOCKED && segAbs(RIGHT) == BLOCKED)
+                moveForward();
+            else
+                mission = SEEK_AFTER_UP;
+            break;
+
+        case SEEK_AFTER_UP:
+            /* if we've found an opening to the right, take it */
+            if (segAbs(RIGHT) == UNBLOCKED)
+                mission = SEEK_RIGHT;
+            /* we are facing up and there are blocks to the front and right of us -- if we are not in the top row, we can
+             * wall hug right until in top row or there is an opening to the right in a row further up in the grid than
+             * the current node's row */
+            else if (current[ROW] > 0)
             {
-                /* save our current coordinates */
-                troubleSpot[ROW] = current[ROW];
-                troubleSpot[COL] = current[COL];
-                stuck = FALSE;
+                hugStart = current[ROW];
+                startWallHug(RIGHT, inTopRow_OR_OpeningToRightUpAbove, (void *)&hugStart, SEEK_AFTER_UP_HUG);
             }
+            else
+                mission = SEEK_TOP_ROW;
+            break;
+
+        case SEEK_AFTER_UP_HUG:
+            /* we've found an opening */
+            if (segAbs(RIGHT) == UNBLOCKED)
+                mission = SEEK_RIGHT;
+            else if (current[ROW] == 0)
+                mission = SEEK_TOP_ROW;
+            else
+                mission = SEEK_DECIDE;
+            break;
+
+        case SEEK_TOP_ROW:
+            /* we are in the top row and the right of us is blocked: move down until you reach the bottom or find an opening */
+            turnAbs(DOWN);
+            startWallHug(LEFT, inBottomRow_OR_OpeningToRight, NULL, SEEK_TAKE_RIGHT);
+            break;
+
+        case SEEK_TAKE_RIGHT:
+            /* we've found an opening */
+            mission = segAbs(RIGHT) == UNBLOCKED ? SEEK_RIGHT : SEEK_DECIDE;
+            break;
+
+        case SEEK_LEFT:
+            if (segAbs(LEFT) == UNBLOCKED && segAbs(DOWN) == BLOCKED)
+                moveForward();
+            else
+                mission = SEEK_AFTER_LEFT;
+            break;
 
-            /* we want to move in the direction that places us more in the center of the grid */
-            /* in this case, moving up gets us closer to center (or we have no other choice) */
-            if ((NUM_ROWS - current[ROW] <= NUM_COLS - current[COL] && segAbs(UP) == UNBLOCKED)
-                 || segAbs(LEFT) == BLOCKED) /* no other choice */
+        case SEEK_AFTER_LEFT:
+            /* if we've found an opening to abs down, take it */
+            if (segAbs(DOWN) == UNBLOCKED)
+                mission = SEEK_DOWN;
+            /* we are facing left and there is a block in front of us -- if we are not in the left-most column, we can wall
+             * hug left until in left-most column or there is an opening to the abs down in a column further left in the
+             * grid than the current node's column */
+            else if (current[COL] > 0)
             {
-                /* move up until we can't go any further or there is an opening to the right */
-                turnAbs(UP);
-                do moveForward(); while (
-                        segAbs(UP) == UNBLOCKED  &&
-                        segAbs(RIGHT) == BLOCKED
-                    );
-                /* if we've found an opening to the right, take it */
-                if (segAbs(RIGHT) == UNBLOCKED)
-                    goto Right_Label;
-                /* we are facing up and there are blocks to the front and right of us */
-                else
-                {
-                    /* if we are not in the top row, we can wall hug right */
-                    if (current[ROW] > 0)
-                    {
-                        tmp = current[ROW];
-                        /* wall hug until in top row or there is an opening to the right in
-                         * a row further up in the grid than the current node's row */
-                        wallHugUntil(RIGHT, inTopRow_OR_OpeningToRightUpAbove, (void *)&tmp);
-                        /* we've found an opening */
-                        if (segAbs(RIGHT) == UNBLOCKED)
-                            goto Right_Label;
-                    }
-                    /* we are in the top row and the right of us is blocked */
-                    if (current[ROW] == 0)
-                    {
-                        turnAbs(DOWN);
-                        /* move down until you reach the bottom or find an opening */
-                        wallHugUntil(LEFT, inBottomRow_OR_OpeningToRight, NULL);
-                        /* we've found an opening */
-                        if (segAbs(RIGHT) == UNBLOCKED)
-                            goto Right_Label;
-                    }
-                }
+                hugStart = current[COL];
+                startWallHug(LEFT, inLeftCol_OR_OpeningBelowToLeft, (void *)&hugStart, SEEK_AFTER_LEFT_HUG);
             }
-            /* in this case, moving left gets us closer to center (or we have no other choice) */
+            else
+                mission = SEEK_LEFT_COL;
+            break;
+
+        case SEEK_AFTER_LEFT_HUG:
+            /* we've found an opening */
+            if (segAbs(DOWN) == UNBLOCKED)
+                mission = SEEK_DOWN;
+            else if (current[COL] == 0)
+                mission = SEEK_LEFT_COL;
+            else
+                mission = SEEK_DECIDE;
+            break;
+
+        case SEEK_LEFT_COL:
+            /* we are in the left-most column and below us is blocked: move right until you reach the far right or find an opening */
+            turnAbs(RIGHT);
+            startWallHug(RIGHT, inRightCol_OR_OpeningBelow, NULL, SEEK_TAKE_DOWN);
+            break;
+
+        case SEEK_TAKE_DOWN:
+            /* we've found an opening */
+            mission = segAbs(DOWN) == UNBLOCKED ? SEEK_DOWN : SEEK_DECIDE;
+            break;
+
+#ifdef PLAN_TO_FLAG
+        case FLAG_PLAN:
+            if (startPath(NUM_ROWS - 1, NUM_COLS - 1, TRUE, FLAG_PLAN, HOME_PLAN))
+                mission = FLAG_FOLLOW;
+            /* the flag is walled off by what the robot knows, which includes every place the enemy robot was ever sensed
+               and never seen open since -- head for it with the heuristic instead, which hugs walls until it gets
+               around whatever is in the way */
             else
             {
-                /* move left until we can't go any further or there is an opening to abs down */
-                turnAbs(LEFT);
-                do moveForward(); while (
-                        segAbs(LEFT) == UNBLOCKED  &&
-                        segAbs(DOWN) == BLOCKED
-                    );
-                /* if we've found an opening to abs down, take it */
-                if (segAbs(DOWN) == UNBLOCKED)
-                    goto Down_Label;
-                /* we are facing left and there is a block in front of us */
-                else
-                {
-                    /* if we are not in the left-most column, we can wall hug left */
-                    if (current[COL] > 0)
-                    {
-                        tmp = current[COL];
-                        /* wall hug until in left-most column or there is an opening to the abs down
-                         * in a column further left in the grid than the current node's column */
-                        wallHugUntil(LEFT, inLeftCol_OR_OpeningBelowToLeft, (void *)&tmp);
-                        /* we've found an opening */
-                        if (segAbs(DOWN) == UNBLOCKED)
-                            goto Down_Label;
-                    }
-                    /* we are in the left-most column and below us is blocked */
-                    if (current[COL] == 0)
-                    {
-                        turnAbs(RIGHT);
-                        /* move right until you reach the far right or find an opening */
-                        wallHugUntil(RIGHT, inRightCol_OR_OpeningBelow, NULL);
-                        /* we've found an opening */
-                        if (segAbs(DOWN) == UNBLOCKED)
-                            goto Down_Label;
-                    }
-                }
+                planToFlag = FALSE;
+                mission = SEEK_DECIDE;
             }
-        }
-        /* there is nothing open, so we need to sit still and read sensors until there is an opening */
-        else
-        {
-            checkForBlocks();
-#ifdef VIRTUAL_BOT
-            controlEnemyRobot();
+            break;
+
+        case FLAG_FOLLOW:
+            followPath();
+            break;
 #endif
-        }
+
+        default:
+            ERROR("moveToFlag should only be run in SEEK states\n")
+            mission = SEEK_DECIDE;
+            break;
     }
+
     return;
 }
 
-/* moves along a wall to relative LEFT or relative RIGHT until condition is met */
-void wallHugUntil(Direction dir, Bool(*condition)(void *), void *args)
+/* starts moving along a wall to relative LEFT or relative RIGHT until condition is met -- then the mission goes on with next */
+void startWallHug(Direction dir, Bool(*condition)(void *), void *args, Mission next)
 {
     if (dir == LEFT || dir == RIGHT)
-        while (!(*condition)(args))
+    {
+        hug.side = dir;
+        hug.until = condition;
+        hug.args = args;
+        hug.next = next;
+        mission = WALL_HUG;
+    }
+    else
+    {
+        ERROR("startWallHug should only be sent LEFT or RIGHT as an argument\n")
+        mission = next;
+    }
+
+    return;
+}
+
+/* moves one node along the wall of the current wall hug, or ends the wall hug once its condition is met */
+void wallHugStep(void)
+{
+    if ((*hug.until)(hug.args))
+        mission = hug.next;
+    else
+    {
+        if (segRel(hug.side) == UNBLOCKED)
         {
-            if (segRel(dir) == UNBLOCKED)
-            {
-                if (dir == LEFT)
-                    turnLeft();
-                else
-                    turnRight();
-            }
-            else if (segRel(FRONT) == BLOCKED)
-            {
-                if (dir == LEFT)
-                    turnRight();
-                else
-                    turnLeft();
-            }
-            moveForward();
+            if (hug.side == LEFT)
+                turnLeft();
+            else
+                turnRight();
         }
-    else
-        ERROR("wallHugUntil should only be sent LEFT or RIGHT as an argument\n")
+        else if (segRel(FRONT) == BLOCKED)
+        {
+            if (hug.side == LEFT)
+                turnRight();
+            else
+                turnLeft();
+        }
+        /* in a corner the turn was not enough to clear the wall -- it is this step's motion, and the next step turns again
+           instead of driving into the wall */
+        if (segRel(FRONT) == UNBLOCKED)
+            moveForward();
+        else
+            motionDone = TRUE;
+    }
 
     return;
 }
 
 /*}}}*/
-/*{{{ RETURN HOME FUNCTIONS */
-PathListNode *pathListNodeContainingTile(Tile t, PathList l, int *out)
+/*{{{ EXPLORATION FUNCTIONS */
+#ifdef EXPLORE
+
+/* makes one motion toward the nearest frontier -- or, once there is none, toward the flag (which the robot may have
+   picked up while exploring). A turn counts as a motion here (unlike in moveToFlag), since facing an unknown Segment is
+   what the turn is for, and the sensors are read after it. */
+void exploreStep(void)
 {
-    static Path p;
-    if (!l) /* no paths in l */
+    Motion first;
+    int cost;
+
+    if (mission == EXPLORING)
     {
-        out = NULL;
-        return NULL;
+        cost = motionSearch(current[ROW], current[COL], direction, seesUnknown, &first, NULL);
+        if (cost < 0)       /* no frontier left -- every Segment the sensors can reach is known */
+        {
+            stopRolling();
+            exploreMotions = motionCount;
+            zigZagSweepMotions = zigZagMotions();
+            mission = EXPLORE_TO_FLAG;
+            return;
+        }
+        if (cost == 0)      /* the sensors can see an unknown Segment from here already -- read them again */
+        {
+            waitOneMove();
+            return;
+        }
     }
-    p = l->path;
-    while (p)       /* check first path in l for c */
+    else
     {
-        if (t.row == p->tile.row && t.col == p->tile.col)
+        if (haveFlag)
+        {
+            mission = HOME_PLAN;
+            return;
+        }
+        cost = motionSearch(current[ROW], current[COL], direction, atFlag, &first, NULL);
+        if (cost <= 0)      /* the flag cannot be reached through known Segments -- search for it the usual way */
         {
-            *out = p->tile.motions;  /* number of motions to get to existing node */
-            return l;               /* pointer to PathListNode with path containing Tile t */
+            mission = SEEK_DECIDE;
+            return;
         }
+    }
+
+    if (first == MOVE_MOTION)
+        moveForward();
+    else
+    {
+        if (first == TURN_LEFT_MOTION)
+            turnLeft();
         else
-            p = p->next;
+            turnRight();
+        motionDone = TRUE;
     }
-    return pathListNodeContainingTile(t, l->next, out);
+
+    return;
 }
 
-Tile *tileInPathList(Tile c, PathList l)
+/* breadth-first search over (row, column, heading) from a state, where every motion (a 90 degree turn, or a move through
+   an UNBLOCKED Segment) costs one -- returns the fewest motions to the first state that passes the goal test, and gives
+   the first motion on the way there and (if not NULL) the state reached; returns -1 if no reachable state passes */
+int motionSearch(int row, int col, Direction heading, Bool (*goal)(int, int, Direction), Motion *first, int reached[3])
 {
-    Path p;
-    if (!l) /* no paths in l */
-        return NULL;
-    p = l->path;    /* first path in l */
-    while (p)       /* check first path in l for c */
+    static unsigned char cost[NUM_ROWS][NUM_COLS][NUM_DIRECTIONS];  /* fewest motions to each state so far */
+    static Motion firstOf[NUM_ROWS][NUM_COLS][NUM_DIRECTIONS];      /* first motion on the way to each state */
+    static short queue[NUM_NODES * NUM_DIRECTIONS];                 /* states (row, column, heading) to expand, in order */
+    int head = 0, tail = 0;     /* queue indexes */
+    int i, j, r, c, nr, nc;     /* LCV's, and the state being expanded and its successor */
+    Direction h, nh;
+    Motion m;
+    Segment *seg;
+
+    for (i = 0; i < NUM_ROWS; ++i)
+        for (j = 0; j < NUM_COLS; ++j)
+            for (h = UP; h <= LEFT; ++h)
+                cost[i][j][h] = MOTION_UNREACHED;
+    cost[row][col][heading] = 0;
+    firstOf[row][col][heading] = NO_MOTION;
+    queue[tail++] = (short)((row * NUM_COLS + col) * NUM_DIRECTIONS + heading);
+
+    while (head < tail)
     {
-        if (c.row == p->tile.row && c.col == p->tile.col)
-            return &p->tile;
-        else
-            p = p->next;
+        h = (Direction)(queue[head] % NUM_DIRECTIONS);
+        c = queue[head] / NUM_DIRECTIONS % NUM_COLS;
+        r = queue[head] / NUM_DIRECTIONS / NUM_COLS;
+        ++head;
+
+        if ((*goal)(r, c, h))
+        {
+            *first = firstOf[r][c][h];
+            if (reached)
+            {
+                reached[0] = r;
+                reached[1] = c;
+                reached[2] = h;
+            }
+            return cost[r][c][h];
+        }
+
+        for (m = TURN_LEFT_MOTION; m <= MOVE_MOTION; ++m)
+        {
+            nr = r;
+            nc = c;
+            nh = h;
+            if (m == MOVE_MOTION)
+            {
+                if (!(seg = segPtrAt(r, c, h)) || *seg != UNBLOCKED)
+                    continue;
+                nr += rowDelta[h];
+                nc += colDelta[h];
+            }
+            else
+                nh = relToAbs(h, m == TURN_LEFT_MOTION ? LEFT : RIGHT);
+
+            if (cost[nr][nc][nh] == MOTION_UNREACHED)
+            {
+                cost[nr][nc][nh] = cost[r][c][h] + 1;
+                firstOf[nr][nc][nh] = firstOf[r][c][h] == NO_MOTION ? m : firstOf[r][c][h];
+                queue[tail++] = (short)((nr * NUM_COLS + nc) * NUM_DIRECTIONS + nh);
+            }
+        }
     }
-    return tileInPathList(c, l->next);
+    return -1;
 }
-void freePath(Path *p)
+
+/* returns TRUE if one of the enabled sensors in sensors[] would see an unknown Segment from a state -- a sensor sees up to
+   its range, and not past the first BLOCKED Segment (its footprint) */
+Bool seesUnknown(int row, int col, Direction heading)
+{
+    int i, k, r, c;
+    Direction dir;
+    Segment *seg;
+
+    for (i = 0; i < NUM_SENSORS; ++i)
+    {
+        if (!sensors[i].enabled)
+            continue;
+        dir = relToAbs(heading, sensors[i].dir);
+        for (k = 0, r = row, c = col; k < sensors[i].range && (seg = segPtrAt(r, c, dir)); ++k)
+        {
+            if (*seg == IDK)
+                return TRUE;
+            if (*seg == BLOCKED)
+                break;
+            r += rowDelta[dir];
+            c += colDelta[dir];
+        }
+    }
+    return FALSE;
+}
+
+/* returns TRUE if a state is in the node of the zig-zag sweep being headed for (in any heading) */
+Bool atRouteTarget(int row, int col, Direction heading)
+{
+    return row == route[routeTarget][ROW] && col == route[routeTarget][COL];
+}
+
+/* returns TRUE if a state is in the bottom-right node (in any heading) */
+Bool atFlag(int row, int col, Direction heading)
+{
+    return row == NUM_ROWS - 1 && col == NUM_COLS - 1;
+}
+
+/* returns the number of motions it takes to visit every node of route in order on the current map, starting from the
+   start space facing DOWN -- nodes that cannot be reached are skipped. The map is known in advance here, so this is a
+   lower bound on what the sweep takes when it has to find the blocks as it goes. */
+int zigZagMotions(void)
+{
+    int state[3] = { 0, 0, DOWN };  /* row, column, and heading of the robot along the sweep */
+    int total = 0, cost;
+    Motion first;
+
+    for (routeTarget = 0; routeTarget < NUM_NODES; ++routeTarget)
+        if ((cost = motionSearch(state[0], state[1], (Direction)state[2], atRouteTarget, &first, state)) > 0)
+            total += cost;
+
+    return total;
+}
+
+/* returns the number of Segments off the border of the grid that are not IDK */
+int knownSegments(void)
+{
+    int k, n = 0;   /* LCV, and number of known Segments */
+
+    for (k = 0; k < NUM_INNER_SEGMENTS; ++k)
+        n += *innerSegment(k) != IDK;
+
+    return n;
+}
+
+#endif
+/*}}}*/
+/*{{{ RETURN HOME FUNCTIONS */
+/* The path helpers below walk their lists with loops rather than recursion: a tree level can hold dozens of paths of
+   up to NUM_ROWS * NUM_COLS nodes each, and the AVR has no room for a frame per node.  Each one uses a single stack
+   frame whatever the length of its Path or PathList, so the worst-case stack of every call chain is bounded (size.sh
+   prints it).  A Path keeps its nodes as arrays of NodeIds and motions (4 bytes a node) in one allocation, so copying,
+   measuring and scanning one never chases a pointer per node. */
+
+/* returns the PathListNode of the first path in l that goes through the node of Tile t, with the number of motions
+   that path takes to get there in out -- NULL if no path does */
+PathListNode *pathListNodeContainingTile(Tile t, PathList l, int *out)
+{
+    int i;
+    for (; l; l = l->next)
+        for (i = 0; i < pathLength(l->path); ++i)   /* check this path in l for t */
+            if (sameNode(l->path->id[i], t.id))
+            {
+                *out = l->path->motions[i]; /* number of motions to get to existing node */
+                return l;               /* pointer to PathListNode with path containing Tile t */
+            }
+    return NULL;
+}
+
+/* finds the first Tile in any path in l on the node of Tile c into out, FALSE if there is none */
+Bool tileInPathList(Tile c, PathList l, Tile *out)
+{
+    int i;
+    for (; l; l = l->next)
+        for (i = 0; i < pathLength(l->path); ++i)   /* check this path in l for c */
+            if (sameNode(l->path->id[i], c.id))
+            {
+                *out = pathTile(l->path, i);
+                return TRUE;
+            }
+    return FALSE;
+}
+/* the PathNodes and both of its arrays come from a single malloc, so a Path is freed with a single free */
+Path newPath(int length)
 {
-    PathNode *pathNodePtr = *p;
-    while (*p)
+    Path p = (Path)malloc(sizeof(PathNodes) + length * (sizeof(NodeId) + sizeof(unsigned short)));
+    if (p)
     {
-        *p = (*p)->next;
-        free(pathNodePtr);
-        pathNodePtr = *p;
+        p->length = length;
+        p->id = (NodeId *)(p + 1);
+        p->motions = (unsigned short *)(p->id + length);
     }
+    return p;
+}
+void freePath(Path *p)
+{
+    free(*p);
+    *p = NULL;
     return;
 }
 void freePathList(PathList *pl)
@@ -1278,214 +2961,220 @@ void freePathList(PathList *pl)
     {
         *pl = (*pl)->next;
         freePath(&pathListNodePtr->path);
+        free(pathListNodePtr);
         pathListNodePtr = *pl;
     }
     return;
 }
 int pathLength(Path p)
 {
-    int length = 0;
-    while (p)
-    {
-        p = p->next;
-        ++length;
-    }
-    return length;
+    return p ? p->length : 0;
 }
-PathNode *lastPathNode(Path p)
+Tile pathTile(Path p, int i)
 {
-    if (!p)
-        ERROR("misuse of lastPathNode\n")
-    else
-        while (p->next)
-            p = p->next;
-    return p;
+    Tile ret;
+
+    ret.id = p->id[i];
+    ret.motions = p->motions[i];
+    return ret;
 }
-Tile relCoordinate(Direction dir, Tile t)
+Tile lastPathNode(Path p)
 {
     Tile ret;
 
-    switch (dir)
+    if (!p || !p->length)
     {
-        case UP:
-            ret.row = t.row - 1;
-            ret.col = t.col;
-            break;
-        case DOWN:
-            ret.row = t.row + 1;
-            ret.col = t.col;
-            break;
-        case LEFT:
-            ret.row = t.row;
-            ret.col = t.col - 1;
-            break;
-        case RIGHT:
-            ret.row = t.row;
-            ret.col = t.col + 1;
-            break;
-        default:
-            ERROR("misuse of relCoordinate\n")
-            break;
+        ERROR("misuse of lastPathNode\n")
+        ret.id = 0;
+        ret.motions = 0;
+        return ret;
     }
+    return pathTile(p, p->length - 1);
+}
+/* assumes there is a node in direction dir from t */
+Tile relCoordinate(Direction dir, Tile t)
+{
+    Tile ret;
+
+    ret.id = (NodeId)(nodeNext(t.id >> 2, dir) << 2 | dir);
+    ret.motions = t.motions;
     return ret;
 }
+/* the border of the grid is always BLOCKED */
 Segment segRelFrom(Direction dir, Tile t)
 {
-    if (dir == UP)
-        return horizSeg[t.row][t.col];
-    else if (dir == DOWN)
-        return horizSeg[t.row + 1][t.col];
-    else if (dir == LEFT)
-        return vertSeg[t.row][t.col];
-    else /* dir == RIGHT */
-        return vertSeg[t.row][t.col + 1];
+    Segment *seg = nodeSeg(t.id >> 2, dir);
+
+    return seg ? *seg : BLOCKED;
 }
+/* copies Path p into a new Path -- the caller frees both the Path and the returned cell */
 Path *copyPath(Path p)
 {
-    Path *tmp, *ret = NULL;
+    Path *ret = NULL;
+    int i;
     if (p)
     {
         ret = (Path *)malloc(sizeof(Path));
-        if (!ret)
-            ERROR("appendPathNode failed to allocate Path\n")
-        else
+        if (!ret || !(*ret = newPath(p->length)))
         {
-            *ret = (PathNode *)malloc(sizeof(PathNode));
-            if (!*ret)
-                ERROR("appendPathNode failed to allocate PathNode\n")
-            else
-            {
-                (*ret)->tile.row = p->tile.row;
-                (*ret)->tile.col = p->tile.col;
-                (*ret)->tile.dir = p->tile.dir;
-                (*ret)->tile.motions = p->tile.motions;
-                tmp = copyPath(p->next);
-                (*ret)->next = tmp ? *tmp : NULL;
-            }
+            ERROR("copyPath failed to allocate Path\n")
+            free(ret);
+            return NULL;
+        }
+        for (i = 0; i < p->length; ++i)
+        {
+            (*ret)->id[i] = p->id[i];
+            (*ret)->motions[i] = p->motions[i];
         }
     }
     return ret;
 }
+
+/* same as copyPath, with Tile t added as the last node (p may be NULL) */
 Path *appendPathNode(Path p, Tile t)
 {
-    Path *ret = NULL;
+    Path *ret;
+    int i, length = pathLength(p);
     ret = (Path *)malloc(sizeof(Path));
-    if (!ret)
+    if (!ret || !(*ret = newPath(length + 1)))
+    {
         ERROR("appendPathNode failed to allocate Path\n")
-    else
+        free(ret);
+        return NULL;
+    }
+    for (i = 0; i < length; ++i)
     {
-        *ret = (PathNode *)malloc(sizeof(PathNode));
-        if (!*ret)
-            ERROR("appendPathNode failed to allocate PathNode\n")
-        else
-        {
-            if (p)
-            {
-                (*ret)->tile.row = p->tile.row;
-                (*ret)->tile.col = p->tile.col;
-                (*ret)->tile.dir = p->tile.dir;
-                (*ret)->tile.motions = p->tile.motions;
-                (*ret)->next = *appendPathNode(p->next, t);
-            }
-            else
-            {
-                {
-                    (*ret)->tile.row = t.row;
-                    (*ret)->tile.col = t.col;
-                    (*ret)->tile.dir = t.dir;
-                    (*ret)->tile.motions = t.motions;
-                    (*ret)->next = NULL;
-                }
-            }
-        }
+        (*ret)->id[i] = p->id[i];
+        (*ret)->motions[i] = p->motions[i];
     }
+    (*ret)->id[length] = t.id;
+    (*ret)->motions[length] = t.motions;
     return ret;
 }
 /* assumes p contains at least one path */
 Bool expandFirstBranchInTree(PathList pl)
 {
-    PathListNode *pathListNodePtr = NULL;
-    PathNode *lastNode = lastPathNode(pl->path); /* pointer to last node in first path in p */
-    PathListNode *existingPath = NULL, *tmp = NULL;
+    Tile moves[NUM_DIRECTIONS]; /* nodes the first path in pl can be extended to */
+    int numMoves, i;
+
+    /* the branch was freed earlier in this level for a faster one to the same node (see mergeBranchMove) -- pruneTree
+       drops it */
+    if (!pl->path)
+        return FALSE;
+    numMoves = branchMoves(pl->path, moves);
+    if (numMoves < 0)   /* should only happen when we start at goal */
+        return TRUE;
+    for (i = 0; i < numMoves; ++i)
+        if (mergeBranchMove(pl, moves[i]))
+            return TRUE;
+    /* we did not find a clear path home, so we return FALSE */
+    return FALSE;
+}
+/* fills moves with the nodes (with the direction and motions to get there) that path p can be extended to, in the order of
+   Direction, and returns how many there are -- or -1 if p already ends home. Only reads the map, the enemy forecast and p,
+   so the branches of a level can be looked at in any order, or all at once (see PARALLEL_PLAN). */
+int branchMoves(Path p, Tile moves[NUM_DIRECTIONS])
+{
+    Tile lastNode;      /* last node in p */
     Tile nextNode;
-    Segment nextSegment;
+    int risk;           /* extra motions a move across the next Segment is expected to cost */
     Direction dir;
+    int numMoves = 0;
+
+    lastNode = lastPathNode(p);
+    if (idCol(lastNode.id) == 0 && idRow(lastNode.id) == 0)
+        return -1;
+    for (dir = UP; dir < NUM_DIRECTIONS; ++dir)
+    {
+        risk = moveRisk(segPtrAt(idRow(lastNode.id), idCol(lastNode.id), dir));
+        /* segment in direction dir from lastNode cannot be crossed */
+        if (risk == SEG_IMPASSABLE)
+            continue;
+        /* robot will always end up facing direction dir when it transitions to the
+           next tile in relative direction dir from its current tile t */
+        nextNode = relCoordinate(dir, lastNode);
+        nextNode.motions = lastNode.motions                     /* number of motions to get here so far */
+                         + turnsBetween(idDir(lastNode.id), dir)/* number of 90 degree turns before moving */
+                         + 1                                    /* moving forward to next node */
+                         + risk;                                /* what the move risks (see moveRisk) */
+
+#ifdef TRACK_ENEMY
+        /* the enemy robot is likely to be in the next node by the time the robot gets there */
+        if (avoidEnemy && enemyChance(idRow(nextNode.id), idCol(nextNode.id), pathSize) >= ENEMY_AVOID)
+            continue;
+#endif
+        moves[numMoves++] = nextNode;
+    }
+    return numMoves;
+}
+/* extends the first path in pl by nextNode (one of its branchMoves) into a new path at the front of pathsHome, unless a
+   path in pathsHome already gets to the node in as few motions -- a path that gets there in more is freed -- and returns
+   TRUE if nextNode is home */
+Bool mergeBranchMove(PathList pl, Tile nextNode)
+{
+    PathListNode *pathListNodePtr = NULL;
+    PathListNode *existingPath = NULL, *tmp = NULL;
     int numMotions;
+    Path *appended;         /* cell appendPathNode returns the new path in */
 
-    if (lastNode->tile.col == 0 && lastNode->tile.row == 0) /* should only evaluate to TRUE when we start at goal */
-        return TRUE;
-    else
-        for (dir = UP; dir < NUM_DIRECTIONS; ++dir)
+    /* nextNode is not already in a path in pathsHome */
+    if(!(existingPath = pathListNodeContainingTile(nextNode, pathsHome, &numMotions)))
+    {
+        /* (1) allocate space for a new list */
+        pathListNodePtr = (PathListNode *)malloc(sizeof(PathListNode));
+        if (!pathListNodePtr)
+            ERROR("Failed to allocate memory for pathListNodePtr in oneDirection\n")
+        else
         {
-            nextSegment = segRelFrom(dir, lastNode->tile);
-            nextNode = relCoordinate(dir, lastNode->tile); /* row, col */
-            /* robot will always end up facing direction dir when it transitions to the
-               next tile in relative direction dir from its current tile t */
-            nextNode.dir = dir;
-            nextNode.motions = lastNode->tile.motions               /* number of motions to get here so far */
-                             + (abs(dir - lastNode->tile.dir) % 2)  /* number of 90 degree turns before moving */
-                             + 1;                                   /* moving forward to next node */
-
-            /* segment in direction dir from lastNode is unblocked */
-            if (nextSegment == UNBLOCKED)
-            {
-                /* node in direction dir from lastNode is not already in a path in pathsHome */
-                if(!(existingPath = pathListNodeContainingTile(nextNode, pathsHome, &numMotions)))
-                {
-                    /* (1) allocate space for a new list */
-                    pathListNodePtr = (PathListNode *)malloc(sizeof(PathListNode));
-                    if (!pathListNodePtr)
-                        ERROR("Failed to allocate memory for pathListNodePtr in oneDirection\n")
-                    else
-                    {
-                        /* (2) create a new list: same as first path in p, except with a new node
-                               in direction dir from last node added to the end */
-                        pathListNodePtr->path = *appendPathNode(pl->path, nextNode);
-
-                        /* (3) add the new list to the front of pathsHome */
-                        pathListNodePtr->next = pathsHome;
-                        pathsHome = pathListNodePtr;
-                    }
-                }
-                /* pathsHome does contain the node, but the number of turns taken to get there is smaller
-                   in the new path */
-                else if (nextNode.motions < numMotions)
-                {
-                    /* (0) remove path containing existing node from pathsHome */
-                    tmp = existingPath->next;
-                    freePath(&existingPath->path);
-                    existingPath = tmp;
-
-                    /* (1) allocate space for a new list */
-                    pathListNodePtr = (PathListNode *)malloc(sizeof(PathListNode));
-                    if (!pathListNodePtr)
-                        ERROR("Failed to allocate memory for pathListNodePtr in oneDirection\n")
-                    else
-                    {
-                        /* (2) create a new list: same as first path in p, except with a new node
-                               in direction dir from last node added to the end */
-                        pathListNodePtr->path = *appendPathNode(pl->path, nextNode);
-
-                        /* (3) add the new list to the front of pathsHome */
-                        pathListNodePtr->next = pathsHome;
-                        pathsHome = pathListNodePtr;
-                    }
-                }
-
-                /* if we have found a clear path home, we return TRUE */
-                if (nextNode.row == 0 && nextNode.col == 0)
-                    return TRUE;
-            }
+            /* (2) create a new list: same as first path in p, except with a new node
+                   in direction dir from last node added to the end */
+            appended = appendPathNode(pl->path, nextNode);
+            pathListNodePtr->path = appended ? *appended : NULL;
+            free(appended);
+
+            /* (3) add the new list to the front of pathsHome */
+            pathListNodePtr->next = pathsHome;
+            pathsHome = pathListNodePtr;
         }
-    /* we did not find a clear path home, so we return FALSE */
-    return FALSE;
+    }
+    /* pathsHome does contain the node, but the number of turns taken to get there is smaller
+       in the new path */
+    else if (nextNode.motions < numMotions)
+    {
+        /* (0) remove path containing existing node from pathsHome */
+        tmp = existingPath->next;
+        freePath(&existingPath->path);
+        existingPath = tmp;
+
+        /* (1) allocate space for a new list */
+        pathListNodePtr = (PathListNode *)malloc(sizeof(PathListNode));
+        if (!pathListNodePtr)
+            ERROR("Failed to allocate memory for pathListNodePtr in oneDirection\n")
+        else
+        {
+            /* (2) create a new list: same as first path in p, except with a new node
+                   in direction dir from last node added to the end */
+            appended = appendPathNode(pl->path, nextNode);
+            pathListNodePtr->path = appended ? *appended : NULL;
+            free(appended);
+
+            /* (3) add the new list to the front of pathsHome */
+            pathListNodePtr->next = pathsHome;
+            pathsHome = pathListNodePtr;
+        }
+    }
+
+    /* if we have found a clear path home, we return TRUE */
+    return idRow(nextNode.id) == 0 && idCol(nextNode.id) == 0;
 }
+#ifndef PARALLEL_PLAN
 Bool expandTreeOneLevel(PathList pl)
 {
     Bool foundPathHome;
     PathList ptr = pl;
-    while (ptr)
+    while (ptr && !planBudgetSpent())
     {
+        ++planExpansions;
         foundPathHome = expandFirstBranchInTree(ptr);
         if (foundPathHome)
             return TRUE;
@@ -1495,6 +3184,176 @@ Bool expandTreeOneLevel(PathList pl)
     /* did not find a path home in this tree level */
     return FALSE;
 }
+#else
+/* The worker pool: worker t (1 to PLAN_THREADS - 1) expands planShares[t] each time planLevel goes up, and the main
+   thread waits for planBusy to come back down to 0 -- the shares are only written while the workers wait, and planLock
+   orders them before the workers read them. */
+pthread_t planWorkers[PLAN_THREADS];
+Bool planWorkerUp[PLAN_THREADS];            /* TRUE if worker t is running -- its share is done by the main thread if not */
+Bool planPoolUp = FALSE;                    /* TRUE once startPlanPool() has run */
+LevelShare planShares[PLAN_THREADS];        /* the shares of the level being expanded */
+pthread_mutex_t planLock = PTHREAD_MUTEX_INITIALIZER;   /* guards planLevel, planBusy and planStopping */
+pthread_cond_t planStart = PTHREAD_COND_INITIALIZER;    /* signalled when planLevel goes up or planStopping is set */
+pthread_cond_t planDone = PTHREAD_COND_INITIALIZER;     /* signalled when planBusy gets to 0 */
+unsigned int planLevel = 0;                 /* number of levels handed to the workers so far */
+int planBusy = 0;                           /* workers still expanding their share of the current level */
+Bool planStopping = FALSE;                  /* TRUE once stopPlanPool() has been called */
+
+/* expands the worker's share of every level, until stopPlanPool() */
+void *planWorkerMain(void *arg)
+{
+    LevelShare *share = (LevelShare *)arg;
+    unsigned int level = 0;     /* last level this worker expanded */
+
+    pthread_mutex_lock(&planLock);
+    while (TRUE)
+    {
+        while (planLevel == level && !planStopping)
+            pthread_cond_wait(&planStart, &planLock);
+        if (planStopping)
+            break;
+        level = planLevel;
+        pthread_mutex_unlock(&planLock);
+        expandShare(share);
+        pthread_mutex_lock(&planLock);
+        if (--planBusy == 0)
+            pthread_cond_signal(&planDone);
+    }
+    pthread_mutex_unlock(&planLock);
+    return NULL;
+}
+
+/* starts the worker threads -- a worker that fails to start leaves its share to the main thread */
+void startPlanPool(void)
+{
+    int t;
+
+    planPoolUp = TRUE;
+    planWorkerUp[0] = FALSE;
+    for (t = 1; t < PLAN_THREADS; ++t)
+        planWorkerUp[t] = !pthread_create(&planWorkers[t], NULL, planWorkerMain, &planShares[t]);
+
+    return;
+}
+
+/* stops the worker threads, once the last level is expanded */
+void stopPlanPool(void)
+{
+    int t;
+
+    if (!planPoolUp)
+        return;
+    pthread_mutex_lock(&planLock);
+    planStopping = TRUE;
+    pthread_cond_broadcast(&planStart);
+    pthread_mutex_unlock(&planLock);
+    for (t = 1; t < PLAN_THREADS; ++t)
+        if (planWorkerUp[t])
+            pthread_join(planWorkers[t], NULL);
+    planPoolUp = FALSE;
+
+    return;
+}
+
+/* same as the serial expandTreeOneLevel, in two steps: first the branches of the level are split into PLAN_THREADS shares
+   of about the same size, and every share finds the moves out of its branches (branchMoves) on a worker of the pool (the
+   first share on this thread); then the moves are merged into pathsHome one branch at a time in the order of the level,
+   stopping just where the serial expansion would -- so the tree comes out the same with any number of threads */
+Bool expandTreeOneLevel(PathList pl)
+{
+    PathList ptr;
+    PathList *branches;             /* branches of the level, in order */
+    Tile (*moves)[NUM_DIRECTIONS];  /* moves out of every branch */
+    int *numMoves;                  /* number of moves out of every branch */
+    int numBranches = 0, i, j, t;
+    Bool ret = FALSE;
+
+    /* only the branches the budget lets the serial expansion get to */
+    for (ptr = pl; ptr; ptr = ptr->next)
+    {
+#ifdef ANYTIME_PLAN
+        if (planExpansions + numBranches >= PLAN_BUDGET)
+            break;
+#endif
+        ++numBranches;
+    }
+    if (!numBranches)
+        return FALSE;
+    branches = (PathList *)malloc(numBranches * sizeof(PathList));
+    moves = (Tile (*)[NUM_DIRECTIONS])malloc(numBranches * sizeof(Tile [NUM_DIRECTIONS]));
+    numMoves = (int *)malloc(numBranches * sizeof(int));
+    if (!branches || !moves || !numMoves)
+    {
+        ERROR("Failed to allocate the level in expandTreeOneLevel -- expanding it one branch at a time\n")
+        free(branches);
+        free(moves);
+        free(numMoves);
+        for (ptr = pl; ptr && !planBudgetSpent(); ptr = ptr->next)
+        {
+            ++planExpansions;
+            if (expandFirstBranchInTree(ptr))
+                return TRUE;
+        }
+        return FALSE;
+    }
+    for (i = 0, ptr = pl; i < numBranches; ++i, ptr = ptr->next)
+        branches[i] = ptr;
+
+    /* (1) find the moves out of every branch, one share per thread */
+    if (!planPoolUp)
+        startPlanPool();
+    pthread_mutex_lock(&planLock);
+    for (t = 0; t < PLAN_THREADS; ++t)
+    {
+        planShares[t].branches = branches;
+        planShares[t].moves = moves;
+        planShares[t].numMoves = numMoves;
+        planShares[t].first = (int)((long)numBranches * t / PLAN_THREADS);
+        planShares[t].last = (int)((long)numBranches * (t + 1) / PLAN_THREADS);
+        if (planWorkerUp[t])
+            ++planBusy;
+    }
+    ++planLevel;
+    pthread_cond_broadcast(&planStart);
+    pthread_mutex_unlock(&planLock);
+    for (t = 0; t < PLAN_THREADS; ++t)
+        if (!planWorkerUp[t])
+            expandShare(&planShares[t]);
+    pthread_mutex_lock(&planLock);
+    while (planBusy > 0)
+        pthread_cond_wait(&planDone, &planLock);
+    pthread_mutex_unlock(&planLock);
+
+    /* (2) merge the moves in the order of the level */
+    for (i = 0; i < numBranches && !ret; ++i)
+    {
+        ++planExpansions;
+        /* the branch was freed earlier in this level for a faster one to the same node (see mergeBranchMove) */
+        if (!branches[i]->path)
+            continue;
+        if (numMoves[i] < 0)    /* should only happen when we start at goal */
+            ret = TRUE;
+        for (j = 0; j < numMoves[i] && !ret; ++j)
+            ret = mergeBranchMove(branches[i], moves[i][j]);
+    }
+
+    free(branches);
+    free(moves);
+    free(numMoves);
+    return ret;
+}
+/* finds the moves out of branches[first] to branches[last - 1] of a LevelShare -- the branches are only read, and the
+   moves only written to the share's own part of moves and numMoves, so the shares of a level can run side by side */
+void *expandShare(void *share)
+{
+    LevelShare *s = (LevelShare *)share;
+    int i;
+
+    for (i = s->first; i < s->last; ++i)
+        s->numMoves[i] = s->branches[i]->path ? branchMoves(s->branches[i]->path, s->moves[i]) : 0;
+    return NULL;
+}
+#endif
 /* In LISP-speak:
  * (define pruneTree
  *   (lambda (pl)
@@ -1506,33 +3365,66 @@ Bool expandTreeOneLevel(PathList pl)
  *       (else
  *        (cons (car pl) (pruneTree (cdr pl)))))))
  */
+/* unlinks and frees the PathListNodes from pruning as it walks pl, so the list is filtered in place; returns pl, or
+   NULL if no path is left */
 PathList *pruneTree(PathList *pl)
 {
-    PathList *ptr;
-    if (!pl || !*pl)
+    PathList *link, dead;
+    if (!pl)
         return NULL;
-    else if (pathLength((*pl)->path) < pathSize)
+    for (link = pl; *link; )
     {
-        ptr = pl;
-        pl = &(*pl)->next;
-        freePath(&(*ptr)->path);
-        return pruneTree(pl);
-    }
-    else
-    {
-        ptr = pruneTree(&(*pl)->next);
-        (*pl)->next = ptr ? *ptr : NULL;
-        return pl;
+        if (pathLength((*link)->path) < pathSize)
+        {
+            dead = *link;
+            *link = dead->next;
+            freePath(&dead->path);
+            free(dead);
+        }
+        else
+            link = &(*link)->next;
     }
+    return *pl ? pl : NULL;
 }
-Path *branchAndBound(void)              /* assumes there is always at least one path home */
+PlanResult branchAndBound(void)         /* assumes there is always at least one path home */
 {
-    PathList *tmp = NULL;
+    PathList *tmp = NULL, ptr;
     Bool stuck = FALSE;
+    PlanResult ret;
+    Tile last, best;                /* last node of a branch, and of the branch closest to home (bestPath) */
+    Path bestPath = NULL;
+
+    ret.path = NULL;
+    ret.optimal = TRUE;
     while (!stuck)
     {
         if (expandTreeOneLevel(pathsHome))
-            return copyPath(pathsHome->path);    /* first path in pathsHome */
+        {
+            ret.path = copyPath(pathsHome->path);    /* first path in pathsHome */
+            return ret;
+        }
+        else if (planBudgetSpent())
+        {
+            /* out of time: take the branch that got closest to home (fewest motions breaks ties), as long as it
+               gets anywhere at all */
+            for (ptr = pathsHome; ptr; ptr = ptr->next)
+            {
+                if (pathLength(ptr->path) < 2)
+                    continue;
+                last = lastPathNode(ptr->path);
+                if (!bestPath || homeDistance(idRow(last.id), idCol(last.id)) < homeDistance(idRow(best.id), idCol(best.id))
+                    || (homeDistance(idRow(last.id), idCol(last.id)) == homeDistance(idRow(best.id), idCol(best.id))
+                        && last.motions < best.motions))
+                {
+                    best = last;
+                    bestPath = ptr->path;
+                }
+            }
+            if (bestPath)
+                ret.path = copyPath(bestPath);
+            ret.optimal = FALSE;
+            return ret;
+        }
         else
         {
             ++pathSize;
@@ -1544,434 +3436,1476 @@ Path *branchAndBound(void)              /* assumes there is always at least one
         }
     }
     /* return NULL if there is no possible way to get home */
-    return NULL;
+    return ret;
 }
-/* needed as function pointer argument in wallHug */
+/* returns how many motions a move across a Segment is expected to cost on top of the move itself, so that the planners
+   prefer moves that are likely to go as planned -- SEG_IMPASSABLE if the Segment is BLOCKED, on the border (NULL), or IDK
+   while the planners may not cross IDK Segments (see planThroughUnknown) */
+int moveRisk(Segment *seg)
+{
+    if (!seg || *seg == BLOCKED)
+        return SEG_IMPASSABLE;
+    else if (*seg == IDK)
+        return planThroughUnknown ? UNKNOWN_PENALTY : SEG_IMPASSABLE;
+#if defined(RISK_AWARE_PLAN) && defined(SMART_SENSE)
+    else if (segInfo(seg)->flags & REOPENED)    /* the enemy robot was blocking it not long ago */
+        return ENEMY_PENALTY;
+#endif
+    else
+        return 0;
+}
+/* fills table with the fewest motions from state (row, col, heading) to every state */
+void costsFrom(int row, int col, Direction heading, CostTable table)
+{
+    int i, j;       /* LCV's */
+    Direction h;    /* LCV */
+
+    for (i = 0; i < NUM_ROWS; ++i)
+        for (j = 0; j < NUM_COLS; ++j)
+            for (h = UP; h < NUM_DIRECTIONS; ++h)
+                table[i][j][h] = COST_UNREACHED;
+    table[row][col][heading] = 0;
+    costSweep(table, FALSE);
+
+    return;
+}
+
+/* fills table with the fewest motions from every state to node (row, col), arriving with any heading */
+void costsTo(int row, int col, CostTable table)
+{
+    int i, j;       /* LCV's */
+    Direction h;    /* LCV */
+
+    for (i = 0; i < NUM_ROWS; ++i)
+        for (j = 0; j < NUM_COLS; ++j)
+            for (h = UP; h < NUM_DIRECTIONS; ++h)
+                table[i][j][h] = i == row && j == col ? 0 : COST_UNREACHED;
+    costSweep(table, TRUE);
+
+    return;
+}
+
+/* Dijkstra-style sweep from every state whose cost is 0: states are settled one cost at a time (every motion costs at
+   least one, so a state is final once the sweep gets to its cost), and each settled state relaxes the states one turn
+   or one move away -- forward for costsFrom, or backward (the states a turn or move comes from) for costsTo */
+void costSweep(CostTable table, Bool backward)
+{
+    int row, col;       /* LCV's */
+    Direction h;        /* LCV: heading */
+    int level;          /* cost of the states being settled */
+    int last = 0;       /* highest cost found so far */
+    int risk;
+
+    for (level = 0; level <= last; ++level)
+        for (row = 0; row < NUM_ROWS; ++row)
+            for (col = 0; col < NUM_COLS; ++col)
+                for (h = UP; h < NUM_DIRECTIONS; ++h)
+                {
+                    if (table[row][col][h] != level)
+                        continue;
+
+                    /* turn 90 degrees either way (a turn comes from a turn the other way) */
+                    costRelax(table, row, col, relToAbs(h, LEFT), level + 1, &last);
+                    costRelax(table, row, col, relToAbs(h, RIGHT), level + 1, &last);
+
+                    /* move to the node in front -- or backward, come from the node behind */
+                    risk = moveRisk(segPtrAt(row, col, backward ? relToAbs(h, BACK) : h));
+                    if (risk == SEG_IMPASSABLE)
+                        continue;
+                    if (backward)
+                        costRelax(table, row - rowDelta[h], col - colDelta[h], h, level + 1 + risk, &last);
+                    else
+                        costRelax(table, row + rowDelta[h], col + colDelta[h], h, level + 1 + risk, &last);
+                }
+
+    return;
+}
+
+/* lowers the cost of state (row, col, heading) to cost if that is cheaper, and raises last to it */
+void costRelax(CostTable table, int row, int col, Direction h, int cost, int *last)
+{
+    if (cost < table[row][col][h])  /* never true for cost >= COST_UNREACHED */
+    {
+        table[row][col][h] = cost;
+        if (cost > *last)
+            *last = cost;
+    }
+
+    return;
+}
+/* needed as function pointer argument in startWallHug */
 Bool inLeftMostColumnOrBottomRow(void *dummy)
 {
     return current[COL] == 0 || current[ROW] == NUM_ROWS - 1;
 }
-/* needed as function pointer argument in wallHug */
+/* needed as function pointer argument in startWallHug */
 Bool inRightMostColumnOrTopRow(void *dummy)
 {
-    return current[COL] == NUM_COLS - 1 || current[ROW] == 0;
+    return current[COL] == NUM_COLS - 1 || current[ROW] == 0;
+}
+/* plans the fastest path from the current node to planGoal (branch and bound always plans home) with what the robot knows
+   right now -- NULL if there is none, or only the start of the most promising path if the planner ran out of budget (see
+   ANYTIME_PLAN) */
+PlanResult planPath(void)
+{
+#ifdef SPACE_TIME_PLAN
+#ifdef PROFILE
+    PlanResult ret;
+
+    PROFILE_BEGIN(PROF_PLAN);
+    planExpansions = 0;
+    ret = spaceTimePlan();
+    PROFILE_END(PROF_PLAN);
+
+    return ret;
+#else
+    planExpansions = 0;
+    return spaceTimePlan();
+#endif
+#else
+    Tile first;
+    PlanResult ret;
+    Path *appended;
+    PathListNode *tmp = (PathListNode *)malloc(sizeof(PathListNode));
+
+    planExpansions = 0;
+    if (!tmp)
+    {
+        ERROR("Failed to allocate memory for tmp in planPath\n")
+        ret.path = NULL;
+        ret.optimal = FALSE;
+        return ret;
+    }
+
+    /*  add current node to pathsHome */
+    first.id = nodeId(current[ROW], current[COL], direction);
+    first.motions = 0;
+    appended = appendPathNode(NULL, first);
+    tmp->path = appended ? *appended : NULL;
+    free(appended);
+    tmp->next = pathsHome;
+    pathsHome = tmp;
+
+    /* initialize pathSize */
+    pathSize = 1;
+
+    /* descend into the dark, murky depths of constructing, navigating, and deallocating a quad tree */
+    PROFILE_BEGIN(PROF_PLAN);
+    ret = branchAndBound();
+    freePathList(&pathsHome);
+    PROFILE_END(PROF_PLAN);
+
+    return ret;
+#endif
+}
+#ifdef SPACE_TIME_PLAN
+/* plans the path to planGoal over (row, column, heading, time), where time is the number of moves (or waits) from now --
+   which is what enemyForecast is indexed by -- and the last time layer stands for every move after ENEMY_HORIZON, when
+   the forecast stops changing. Every motion (a move to the next node, a 90 degree turn, or a wait in place) costs one,
+   plus UNKNOWN_PENALTY for a move across an IDK Segment when planThroughUnknown, and a node the enemy robot is forecast
+   to be in is an obstacle only at the time it is forecast to be there, so the robot can wait for the enemy robot to pass
+   instead of detouring or running into it. States are expanded in order of their cost so far plus goalDistance (which
+   never overestimates), one level at a time, so the first time the goal is reached within a level it is reached with
+   the fewest motions. A wait shows up as a repeated node in the returned path. */
+PlanResult spaceTimePlan(void)
+{
+    int t, row, col;        /* LCV's */
+    Direction h;            /* LCV: heading */
+    int bestT;              /* time layer of the cheapest goal state reached, -1 if none */
+    Direction bestH = UP;   /* heading of the cheapest goal state reached */
+    unsigned char level;    /* cost so far plus goalDistance of the states being expanded */
+    unsigned char cost;
+    Bool progress;          /* TRUE if a pass over the states expanded anything */
+    Bool open;              /* TRUE if any state is left for a later level */
+    Segment *seg;
+    PlanResult ret;
+
+    for (t = 0; t < ST_TIMES; ++t)
+        for (row = 0; row < NUM_ROWS; ++row)
+            for (col = 0; col < NUM_COLS; ++col)
+                for (h = UP; h < NUM_DIRECTIONS; ++h)
+                    stCost[t][row][col][h] = ST_UNREACHED;
+    for (t = 0; t < (int)sizeof(stExpanded); ++t)
+        stExpanded[t] = 0;
+    stCost[0][current[ROW]][current[COL]][direction] = 0;
+    ret.path = NULL;
+    ret.optimal = TRUE;
+
+    for (level = goalDistance(current[ROW], current[COL]); level < ST_UNREACHED - 1; ++level)
+    {
+        /* stop at the first level that reaches the goal -- with the cheapest of the goal states reached so far, as
+           expanding the first one on the last level also reached the goal again, a turn in place later */
+        bestT = -1;
+        for (t = 0; t < ST_TIMES; ++t)
+            for (h = UP; h < NUM_DIRECTIONS; ++h)
+                if (stCost[t][planGoal[ROW]][planGoal[COL]][h] <= level
+                    && (bestT < 0 || stCost[t][planGoal[ROW]][planGoal[COL]][h]
+                                     < stCost[bestT][planGoal[ROW]][planGoal[COL]][bestH]))
+                {
+                    bestT = t;
+                    bestH = h;
+                }
+        if (bestT >= 0)
+        {
+            ret.path = stBacktrack(bestT, planGoal[ROW], planGoal[COL], bestH);
+            return ret;
+        }
+
+        /* expanding a state on this level can reach more states on this level (by moving toward home) */
+        open = FALSE;
+        do
+        {
+            progress = FALSE;
+            for (t = 0; t < ST_TIMES; ++t)
+                for (row = 0; row < NUM_ROWS; ++row)
+                    for (col = 0; col < NUM_COLS; ++col)
+                        for (h = UP; h < NUM_DIRECTIONS; ++h)
+                        {
+                            cost = stCost[t][row][col][h];
+                            if (cost == ST_UNREACHED || (stExpanded[stBit(t, row, col, h) / CHAR_BIT]
+                                                         & (1 << stBit(t, row, col, h) % CHAR_BIT)))
+                                continue;
+                            if (cost + goalDistance(row, col) > level)
+                            {
+                                open = TRUE;
+                                continue;
+                            }
+                            if (planBudgetSpent())
+                            {
+                                ret.path = stBestSoFar();
+                                ret.optimal = FALSE;
+                                return ret;
+                            }
+                            ++planExpansions;
+                            stExpanded[stBit(t, row, col, h) / CHAR_BIT] |= 1 << stBit(t, row, col, h) % CHAR_BIT;
+                            progress = TRUE;
+
+                            /* turn 90 degrees either way */
+                            stReach(t, row, col, relToAbs(h, LEFT), cost + 1);
+                            stReach(t, row, col, relToAbs(h, RIGHT), cost + 1);
+                            /* move to the next node in front */
+                            seg = segPtrAt(row, col, h);
+                            if (seg && stPassable(seg) && !stThreat(row + rowDelta[h], col + colDelta[h], stLater(t)))
+                                stReach(stLater(t), row + rowDelta[h], col + colDelta[h], h, cost + stStep(seg));
+                            /* wait in place -- never worth it past the forecast */
+                            if (t < ENEMY_HORIZON && !stThreat(row, col, t + 1))
+                                stReach(t + 1, row, col, h, cost + 1);
+                        }
+        } while (progress);
+        if (!open)  /* every reachable state has been expanded */
+            break;
+    }
+
+    /* there is no way to get home */
+    return ret;
+}
+
+/* records that a state can be reached with a given cost, unless it has already been reached at least as cheaply */
+void stReach(int t, int row, int col, Direction h, int cost)
+{
+    if (cost < stCost[t][row][col][h])
+        stCost[t][row][col][h] = cost;
+
+    return;
+}
+
+/* when the budget runs out: returns the path to the state reached so far that is closest to planGoal (fewest motions
+   breaks ties), not counting states at the current node -- NULL if nothing but the current node has been reached */
+Path *stBestSoFar(void)
+{
+    int t, row, col, bestT = 0, bestRow = -1, bestCol = 0;
+    Direction h, bestH = UP;
+
+    for (t = 0; t < ST_TIMES; ++t)
+        for (row = 0; row < NUM_ROWS; ++row)
+            for (col = 0; col < NUM_COLS; ++col)
+                for (h = UP; h < NUM_DIRECTIONS; ++h)
+                {
+                    if (stCost[t][row][col][h] == ST_UNREACHED || (row == current[ROW] && col == current[COL]))
+                        continue;
+                    if (bestRow < 0 || goalDistance(row, col) < goalDistance(bestRow, bestCol)
+                        || (goalDistance(row, col) == goalDistance(bestRow, bestCol)
+                            && stCost[t][row][col][h] < stCost[bestT][bestRow][bestCol][bestH]))
+                    {
+                        bestT = t;
+                        bestRow = row;
+                        bestCol = col;
+                        bestH = h;
+                    }
+                }
+
+    return bestRow < 0 ? NULL : stBacktrack(bestT, bestRow, bestCol, bestH);
+}
+
+/* walks stCost back from a reached state (time layer t, node (row, col), heading h) to the current state, one motion
+   cheaper at each step, and returns the nodes along the way as a Path that starts at the current node -- turns in place
+   add no node, and waits add the same node again */
+Path *stBacktrack(int t, int row, int col, Direction h)
+{
+    int length = stWalkBack(t, row, col, h, NULL);  /* nodes after the current node */
+    Path *ret;
+
+    if (length < 0)
+        return NULL;
+    ret = (Path *)malloc(sizeof(Path));
+    if (!ret || !(*ret = newPath(length + 1)))
+    {
+        ERROR("stBacktrack failed to allocate Path\n")
+        free(ret);
+        return NULL;
+    }
+
+    /* the path starts at the current node */
+    (*ret)->id[0] = nodeId(current[ROW], current[COL], direction);
+    (*ret)->motions[0] = 0;
+    stWalkBack(t, row, col, h, *ret);
+
+    return ret;
+}
+
+/* does the walk of stBacktrack, and returns the number of nodes along the way (-1 if it gets lost) -- the nodes are
+   found last one first, so stBacktrack walks twice: once to size the Path, and once more to fill path in from its end */
+int stWalkBack(int t, int row, int col, Direction h, Path path)
+{
+    int pt;
+    unsigned char cost = stCost[t][row][col][h];
+    unsigned char nodeCost; /* cost of the node being added */
+    Direction turned;
+    Segment *seg;
+    Bool found;
+    int step = 1;   /* cost of the move or wait being undone */
+    int added = 0;  /* nodes found so far */
+
+    while (cost > 0)
+    {
+        /* a node is added for every move and wait */
+        nodeCost = cost;
+
+        /* undo any turns in place */
+        found = TRUE;
+        while (found && cost > 0)
+        {
+            found = FALSE;
+            turned = relToAbs(h, LEFT);
+            if (stCost[t][row][col][turned] != cost - 1)
+                turned = relToAbs(h, RIGHT);
+            if (stCost[t][row][col][turned] == cost - 1)
+            {
+                h = turned;
+                --cost;
+                found = TRUE;
+            }
+        }
+        if (cost == 0)  /* turned in place at the current node -- this node is never added */
+            break;
+        ++added;
+        if (path)
+        {
+            path->id[path->length - added] = nodeId(row, col, h);  /* heading it was entered with */
+            path->motions[path->length - added] = nodeCost;
+        }
+
+        /* undo the move or wait that got here: it started one time layer earlier, or in the last
+           time layer if this is the last time layer */
+        found = FALSE;
+        for (pt = t - 1; !found && pt <= t && pt < ST_TIMES; ++pt)
+        {
+            if (pt < 0 || (pt == t && t < ENEMY_HORIZON))
+                continue;
+            seg = segPtrAt(row, col, relToAbs(h, BACK));
+            if (seg && stPassable(seg)
+                && stCost[pt][row - rowDelta[h]][col - colDelta[h]][h] == cost - stStep(seg))
+            {
+                row -= rowDelta[h];
+                col -= colDelta[h];
+                step = stStep(seg);
+                found = TRUE;
+            }
+            else if (pt < t && stCost[pt][row][col][h] == cost - 1)
+            {
+                step = 1;
+                found = TRUE;
+            }
+            if (found)
+                t = pt;
+        }
+        if (!found)
+        {
+            ERROR("stBacktrack lost its way back\n")
+            return -1;
+        }
+        cost -= step;
+    }
+
+    return added;
+}
+#endif
+/* advances the robot toward the upper-left-most node in the grid by one state of the mission -- as quickly as possible
+   with known info */
+void returnHome(void)
+{
+    switch (mission)
+    {
+        case HOME_PLAN:
+            if (startPath(0, 0, homeThroughUnknown, HOME_PLAN, MISSION_DONE))
+                mission = HOME_FOLLOW;
+            /* if there is no way to get home */
+            else
+            {
+                turnAbs(UP);
+                mission = HOME_ESCAPE;
+            }
+            break;
+
+        case HOME_FOLLOW:
+            followPath();
+            break;
+
+        case HOME_ESCAPE:
+            if (segAbs(UP) != BLOCKED)
+                moveForward();
+            else
+                mission = HOME_HUG_LEFT;
+            break;
+
+        case HOME_HUG_LEFT:
+            /* TODO: Break out of this when you can calculate */
+            if (current[ROW] == 0 && current[COL] == 0)
+                mission = MISSION_DONE;
+            else
+            {
+                turnAbs(LEFT);
+                startWallHug(RIGHT, inLeftMostColumnOrBottomRow, NULL, HOME_HUG_RIGHT);
+            }
+            break;
+
+        case HOME_HUG_RIGHT:
+            /* both wall hugs are over before they start in the corners of the grid (as at the flag, where PLAN_TO_FLAG
+               can leave the robot walled in by sightings of the enemy robot) -- wait for the way home to open instead */
+            if (inLeftMostColumnOrBottomRow(NULL) && inRightMostColumnOrTopRow(NULL))
+            {
+                waitOneMove();
+                mission = HOME_PLAN;
+            }
+            else
+            {
+                turnAbs(RIGHT);
+                startWallHug(LEFT, inRightMostColumnOrTopRow, NULL, HOME_HUG_LEFT);
+            }
+            break;
+
+        default:
+            ERROR("returnHome should only be run in HOME states\n")
+            mission = HOME_PLAN;
+            break;
+    }
+
+    return;
+}
+/* plans the fastest path from the current node to node (row, col) into fastestPath, and gets ready to follow it: once the
+   path cannot be followed as planned, the mission goes on with replan, and once it gets to the node, with done --
+   returns FALSE if there is no path (fastestPath is NULL then) */
+Bool startPath(int row, int col, Bool throughUnknown, Mission replan, Mission done)
+{
+    PlanResult plan;
+
+    stopRolling();
+    if (fastestPath)
+    {
+        freePath(fastestPath);
+        free(fastestPath);
+    }
+    planGoal[ROW] = row;
+    planGoal[COL] = col;
+    planThroughUnknown = throughUnknown;
+    followReplan = replan;
+    followDone = done;
+
+#ifdef TRACK_ENEMY
+    /* route around where the enemy robot is going, unless that leaves no way there at all */
+    avoidEnemy = TRUE;
+    if (!(plan = planPath()).path)
+    {
+        avoidEnemy = FALSE;
+        plan = planPath();
+    }
+#else
+    plan = planPath();
+#endif
+    fastestPath = plan.path;
+    planOptimal = plan.optimal;
+    if (!fastestPath)
+        return FALSE;
+
+    pathCursor = 1;     /* the path starts at the current node */
+    followStarted = FALSE;
+
+    return TRUE;
+}
+/* TEST ONLY */
+#ifdef VIRTUAL_BOT
+
+char *DirectionToStr(Direction dir)
+{
+    switch (dir)
+    {
+        case UP:    return "UP";        break;
+        case DOWN:  return "DOWN";      break;
+        case LEFT:  return "LEFT";      break;
+        case RIGHT: return "RIGHT";     break;
+        default:    return "INVALID";   break;
+    }
+}
+
+void displayPath(Path p)
+{
+    int i;
+    printf("START");
+    for (i = 0; i < pathLength(p); ++i)
+        printf("(%d, %d)", idRow(p->id[i]), idCol(p->id[i]));
+    printf("END\n");
+
+    return;
+}
+void displayPathList(PathList pl)
+{
+    int i = 0;
+    PathList ptr = pl;
+    while (ptr)
+    {
+        printf("%d: ", i++);
+        displayPath(ptr->path);
+        ptr = ptr->next;
+    }
+    printf("\n");
+    return;
+}
+int getTileIndex(int a, int b)
+{
+    int i;
+    for (i = 0; i < pathLength(*fastestPath); ++i)
+        if (idRow((*fastestPath)->id[i]) == a && idCol((*fastestPath)->id[i]) == b)
+            return i;
+    /* (a, b) not in fastestPath */
+    return -1;
+}
+#endif
+/* followPath moves the robot to the next node of fastestPath (pathCursor), a list of adjacent nodes on the grid. Once the
+ * robot makes it to the end of the path, the mission goes on with followDone; if the rest of the path cannot be followed
+ * as planned anymore, the mission goes on with followReplan (see startPath).
+ */
+void followPath(void)
+{
+    Direction dir;
+    int row, col;   /* next node */
+
+    PROFILE_BEGIN(PROF_FOLLOW);
+    /* a partial plan (see ANYTIME_PLAN) is improved on after every node */
+#ifdef SMART_SENSE
+    /* blocks off the path cannot slow it down, but an unknown Segment found open can make another path faster */
+    if (followStarted && (!planOptimal || segmentsOpened || pathObstructed(*fastestPath, pathCursor)))
+#else
+    if (followStarted && (!planOptimal || segmentsChanged))
+#endif
+    {
+        mission = followReplan;
+        PROFILE_END(PROF_FOLLOW);
+        return;
+    }
+
+    if (pathCursor >= pathLength(*fastestPath))
+    {
+        mission = current[ROW] == planGoal[ROW] && current[COL] == planGoal[COL] ? followDone : followReplan;
+        PROFILE_END(PROF_FOLLOW);
+        return;
+    }
+
+    /* next node is the current node -- wait in place (e.g. for the enemy robot to pass) */
+    row = idRow((*fastestPath)->id[pathCursor]);
+    col = idCol((*fastestPath)->id[pathCursor]);
+    if ((current[ROW] == row) && (current[COL] == col))
+        waitOneMove();
+    else
+    {
+        /* next node is UP */
+        if ((current[ROW] == row + 1) && (current[COL] == col))
+            dir = UP;
+        /* next node is DOWN */
+        else if ((current[ROW] == row - 1) && (current[COL] == col))
+            dir = DOWN;
+        /* next node is LEFT */
+        else if ((current[ROW] == row) && (current[COL] == col + 1))
+            dir = LEFT;
+        /* next node is RIGHT */
+        else if ((current[ROW] == row) && (current[COL] == col - 1))
+            dir = RIGHT;
+        /* all Nodes in the path are adjacent -- the robot is not where the plan thinks it is, so plan again from here */
+        else
+        {
+            ERROR("Logic Error: Next node of the path is not adjacent to the current node\n")
+            mission = followReplan;
+            PROFILE_END(PROF_FOLLOW);
+            return;
+        }
+
+        /* TURN TO FACE APPROPRIATE DIRECTION */
+        turnAbs(dir);
+
+        /* move to next node if able, otherwise plan again -- nodes that continue in a straight line are driven through
+           without stopping (see moveForward). The path is only advanced once the robot is actually in its next node. */
+        if (segRel(FRONT) == IDK)   /* planned through the unknown (see PLAN_TO_FLAG) -- look before driving into it */
+            senseSegments();
+        if (segRel(FRONT) != UNBLOCKED || !moveForward())
+        {
+            mission = followReplan;
+            PROFILE_END(PROF_FOLLOW);
+            return;
+        }
+    }
+
+    followStarted = TRUE;
+    ++pathCursor;
+    PROFILE_END(PROF_FOLLOW);
+
+    return;
+}
+
+/* returns TRUE if the rest of a path (starting with its node i, the node after the current node) can no longer be
+   followed as planned: a Segment along it is BLOCKED now, or IDK while the planner may not cross IDK Segments (see
+   planThroughUnknown), or (with TRACK_ENEMY) the enemy robot is forecast to be in one of its nodes when the robot gets
+   there. A path that is not obstructed can still be followed, but it is not always the fastest path anymore: Segments
+   found open and a changed enemy forecast can make another path faster (see segmentsOpened). */
+Bool pathObstructed(Path path, int i)
+{
+    Tile from;      /* node before node i */
+    NodeId id;      /* node i */
+    int moves = 1;  /* number of moves from the current node to node i */
+
+    from.id = nodeId(current[ROW], current[COL], direction);
+    for (; i < pathLength(path); ++i, ++moves)
+    {
+        id = path->id[i];
+        /* a repeated node is a wait, which crosses no Segment */
+        if (!sameNode(id, from.id) && (segRelFrom(idDir(id), from) == BLOCKED
+                || (segRelFrom(idDir(id), from) == IDK && !planThroughUnknown)))
+            return TRUE;
+#ifdef TRACK_ENEMY
+        if (avoidEnemy && enemyChance(idRow(id), idCol(id), moves) >= ENEMY_AVOID)
+            return TRUE;
+#endif
+        from.id = id;
+    }
+    return FALSE;
+}
+/*}}}*/
+/*{{{ VIRTUAL OBJECT PRESENCE FUNCTIONS */
+#ifdef VIRTUAL_BOT
+/* packs blockedHorizSeg and blockedVertSeg (plus the grid border, which blocks sensors like any other wall) into
+   blockedHorizBits and blockedVertBits -- called once the virtual blocks have been placed */
+void packBlockedSegments(void)
+{
+    int i, j;   /* LCV's */
+
+    for (j = 0; j < NUM_HORIZ_SEG_COLS; ++j)
+        for (i = 0; i < WORDS_FOR(NUM_HORIZ_SEG_ROWS); ++i)
+            blockedHorizBits[j][i] = 0;
+    for (i = 0; i < NUM_VERT_SEG_ROWS; ++i)
+        for (j = 0; j < WORDS_FOR(NUM_VERT_SEG_COLS); ++j)
+            blockedVertBits[i][j] = 0;
+
+    for (i = 0; i < NUM_HORIZ_SEG_ROWS; ++i)
+        for (j = 0; j < NUM_HORIZ_SEG_COLS; ++j)
+            if (blockedHorizSeg[i][j] == BLOCKED || i == 0 || i == NUM_HORIZ_SEG_ROWS - 1)
+                blockedHorizBits[j][i / BITS_PER_WORD] |= 1u << (i % BITS_PER_WORD);
+    for (i = 0; i < NUM_VERT_SEG_ROWS; ++i)
+        for (j = 0; j < NUM_VERT_SEG_COLS; ++j)
+            if (blockedVertSeg[i][j] == BLOCKED || j == 0 || j == NUM_VERT_SEG_COLS - 1)
+                blockedVertBits[i][j / BITS_PER_WORD] |= 1u << (j % BITS_PER_WORD);
+
+    return;
+}
+
+/* returns the offset of the first set bit among count bits of a packed row of bits, starting at bit 'from' and stepping
+   by 'step' (1 or -1) -- -1 if none of them is set. Words with no bits set are skipped all at once. */
+int scanBits(const unsigned int *bits, int from, int step, int count)
+{
+    int k = 0, bit;
+    unsigned int word;
+
+    while (k < count)
+    {
+        bit = from + step * k;
+        word = bits[bit / BITS_PER_WORD];
+        if (!word)  /* skip to the first bit of the next word in the direction of the scan */
+            k += step > 0 ? BITS_PER_WORD - bit % BITS_PER_WORD : bit % BITS_PER_WORD + 1;
+        else if ((word >> (bit % BITS_PER_WORD)) & 1u)
+            return k;
+        else
+            ++k;
+    }
+    return -1;
+}
+
+/* returns the distance (in segments, 1 to range) from node at to the first virtual block, grid border, or enemy robot
+   (at node foeAt) in absolute Direction absDir -- 0 if there is nothing within range segments
+   THIS FUNCTION IS USED TO INDICATE THE PRESENCE OF A VIRTUAL GRID BLOCK */
+short virtualRayCast(const int at[2], const int foeAt[2], Direction absDir, short range)
+{
+    int block;  /* offset of first blocked segment along the ray, -1 if none */
+    int foe;    /* number of nodes to the enemy robot along the ray, 0 if not in line with the ray */
+
+    if (absDir == UP)
+        block = scanBits(blockedHorizBits[at[COL]], at[ROW], -1, range);
+    else if (absDir == DOWN)
+        block = scanBits(blockedHorizBits[at[COL]], at[ROW] + 1, 1, range);
+    else if (absDir == LEFT)
+        block = scanBits(blockedVertBits[at[ROW]], at[COL], -1, range);
+    else /* absDir == RIGHT */
+        block = scanBits(blockedVertBits[at[ROW]], at[COL] + 1, 1, range);
+
+    /* the enemy robot blocks the segment in front of the node it occupies */
+    foe = (foeAt[ROW] - at[ROW]) * rowDelta[absDir] + (foeAt[COL] - at[COL]) * colDelta[absDir];
+    if (rowDelta[absDir] ? foeAt[COL] != at[COL] : foeAt[ROW] != at[ROW])
+        foe = 0;
+
+    if (foe > 0 && foe <= range && (block < 0 || foe <= block))
+        return foe;
+    else
+        return block + 1;
+}
+
+#endif
+/* }}} */
+/*{{{ BENCHMARK FUNCTIONS */
+#ifdef BENCHMARK
+/* runs the mission with the heuristic and with the planner of PLAN_TO_FLAG on the same BENCH_LAYOUTS random layouts of
+   blocks, with no enemy robot on the grid, and reports how many motions each took to capture the flag and to get back
+   home with it -- averaged over the layouts both of them finished -- and the distribution of their competitive ratios:
+   the motions each leg took over the fewest motions it could have taken with the whole layout known (see oracleCosts) */
+void runBenchmark(void)
+{
+    int layout;                             /* LCV */
+    int way;                                /* LCV: 0 for the heuristic, 1 for the planner */
+    unsigned int flagMotions[2];            /* motions to capture the flag in this layout */
+    unsigned int motions[2];                /* motions for the whole mission in this layout */
+    Direction flagHeading[2];               /* heading the flag was captured with in this layout */
+    Bool finished[2];                       /* FALSE if the mission did not finish within BENCH_MAX_TICKS */
+    unsigned long flagTotal[2] = { 0, 0 };
+    unsigned long total[2] = { 0, 0 };
+    int stuckRuns[2] = { 0, 0 };
+    int compared = 0, fewer = 0, more = 0;  /* layouts both finished, and where the planner took fewer/more motions */
+    int bestToFlag, bestHome[NUM_DIRECTIONS], bestMission;  /* fewest motions possible in this layout */
+    static double ratios[2][3][BENCH_LAYOUTS];  /* [way][to the flag, home, whole mission][run]: competitive ratios */
+    int numRatios[2] = { 0, 0 };            /* runs of each way that finished */
+
+    srand(BENCH_SEED);
+    enemy[ROW] = enemy[COL] = -NUM_ROWS - NUM_COLS;  /* off the grid, out of sight of every sensor */
+    for (layout = 0; layout < BENCH_LAYOUTS; ++layout)
+    {
+        randomLayout();
+        oracleCosts(&bestToFlag, bestHome, &bestMission);
+        for (way = 0; way < 2; ++way)
+        {
+            finished[way] = benchRun(way == 1, &flagMotions[way], &flagHeading[way]) >= 0;
+            motions[way] = motionCount;
+            if (!finished[way])
+            {
+                ++stuckRuns[way];
+                continue;
+            }
+            ratios[way][0][numRatios[way]] = (double)flagMotions[way] / bestToFlag;
+            ratios[way][1][numRatios[way]] = (double)(motions[way] - flagMotions[way]) / bestHome[flagHeading[way]];
+            ratios[way][2][numRatios[way]] = (double)motions[way] / bestMission;
+            ++numRatios[way];
+        }
+        if (finished[0] && finished[1])
+        {
+            ++compared;
+            for (way = 0; way < 2; ++way)
+            {
+                flagTotal[way] += flagMotions[way];
+                total[way] += motions[way];
+            }
+            if (flagMotions[1] < flagMotions[0])
+                ++fewer;
+            else if (flagMotions[1] > flagMotions[0])
+                ++more;
+        }
+    }
+
+    printf("benchmark: %d layouts of %d blocks (seed %d), %d finished both ways\n",
+           BENCH_LAYOUTS, BENCH_BLOCKS, BENCH_SEED, compared);
+    if (compared)
+        for (way = 0; way < 2; ++way)
+            printf("  %-10s %6.1f motions to the flag, %6.1f for the whole mission, stuck in %d layouts\n",
+                   way ? "planner:" : "heuristic:", (double)flagTotal[way] / compared, (double)total[way] / compared,
+                   stuckRuns[way]);
+    printf("  planner got to the flag in fewer motions in %d layouts, in more in %d\n", fewer, more);
+
+    printf("competitive ratio (motions taken / fewest possible knowing the layout), over the layouts each finished:\n");
+    printf("                        runs   mean median    p90    max  optimal  <=1.25   <=1.5     <=2      >2\n");
+    for (way = 0; way < 2; ++way)
+    {
+        reportRatios(way ? "planner to flag:" : "heuristic to flag:", ratios[way][0], numRatios[way]);
+        reportRatios(way ? "planner home:" : "heuristic home:", ratios[way][1], numRatios[way]);
+        reportRatios(way ? "planner mission:" : "heuristic mission:", ratios[way][2], numRatios[way]);
+    }
+
+    return;
+}
+
+/* prints one line of the competitive ratio table: how many ratios there are, their mean, median, 90th percentile and
+   maximum, and how many of them fall in each bucket (sorts ratios) */
+void reportRatios(const char *label, double *ratios, int count)
+{
+    int i;  /* LCV */
+    double sum = 0;
+    int buckets[5] = { 0, 0, 0, 0, 0 };     /* optimal, up to 1.25, up to 1.5, up to 2, over 2 */
+
+    if (!count)
+    {
+        printf("  %-20s %5d\n", label, count);
+        return;
+    }
+    qsort(ratios, count, sizeof(double), compareRatios);
+    for (i = 0; i < count; ++i)
+    {
+        sum += ratios[i];
+        if (ratios[i] <= 1.0)
+            ++buckets[0];
+        else if (ratios[i] <= 1.25)
+            ++buckets[1];
+        else if (ratios[i] <= 1.5)
+            ++buckets[2];
+        else if (ratios[i] <= 2.0)
+            ++buckets[3];
+        else
+            ++buckets[4];
+    }
+    printf("  %-20s %5d %6.2f %6.2f %6.2f %6.2f %8d %7d %7d %7d %7d\n", label, count, sum / count, ratios[count / 2],
+           ratios[count * 9 / 10], ratios[count - 1], buckets[0], buckets[1], buckets[2], buckets[3], buckets[4]);
+
+    return;
+}
+
+int compareRatios(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+
+    return x < y ? -1 : x > y;
 }
-void returnHome(void)
+
+/* ORACLE: fills in the fewest motions possible on the current layout for a robot that knows where every block is from
+   the start -- to capture the flag (from the start state), to get home from the flag with each heading, and for the
+   whole mission -- by exact search over (row, column, heading) with costsFrom and costsTo. Leaves the robot's memory as
+   the whole layout; benchRun starts it over. */
+void oracleCosts(int *toFlag, int home[NUM_DIRECTIONS], int *mission)
 {
-    Tile first;
-    PathListNode *tmp = (PathListNode *)malloc(sizeof(PathListNode));
+    int k;          /* LCV */
+    Direction h;    /* LCV */
+    Segment *seg;
+    CostTable fromStart, toHome;
+
+    initializeGlobalVariables();    /* start state, and a robot's memory with no history of readings */
+    for (k = 0; k < NUM_INNER_SEGMENTS; ++k)
+    {
+        seg = innerSegment(k);
+        *seg = *virtualBlock(seg) == BLOCKED ? BLOCKED : UNBLOCKED;
+    }
+    costsFrom(current[ROW], current[COL], direction, fromStart);
+    costsTo(0, 0, toHome);
 
-    do
+    *toFlag = *mission = COST_UNREACHED * 2;
+    for (h = UP; h < NUM_DIRECTIONS; ++h)
     {
-        /*  add current node to pathsHome */
-        first.row = current[ROW];
-        first.col = current[COL];
-        first.dir = direction;
-        first.motions = 0;
-        tmp->path = *appendPathNode(NULL, first);
-        tmp->next = pathsHome;
-        pathsHome = tmp;
+        home[h] = toHome[NUM_ROWS - 1][NUM_COLS - 1][h];
+        if (fromStart[NUM_ROWS - 1][NUM_COLS - 1][h] < *toFlag)
+            *toFlag = fromStart[NUM_ROWS - 1][NUM_COLS - 1][h];
+        if (fromStart[NUM_ROWS - 1][NUM_COLS - 1][h] + home[h] < *mission)
+            *mission = fromStart[NUM_ROWS - 1][NUM_COLS - 1][h] + home[h];
+    }
+
+    return;
+}
 
-        /* initialize pathSize */
-        pathSize = 1;
+/* returns the Segment of the virtual grid (blockedHorizSeg or blockedVertSeg) at the same place as a Segment of the
+   robot's memory (horizSeg or vertSeg) */
+Segment *virtualBlock(Segment *seg)
+{
+    if (seg >= &horizSeg[0][0] && seg < &horizSeg[0][0] + NUM_HORIZ_SEG_ROWS * NUM_HORIZ_SEG_COLS)
+        return &blockedHorizSeg[0][0] + (seg - &horizSeg[0][0]);
+    else
+        return &blockedVertSeg[0][0] + (seg - &vertSeg[0][0]);
+}
 
-        /* descend into the dark, murky depths of constructing, navigating, and deallocating a quad tree */
-        fastestPath = branchAndBound();
-        freePathList(&pathsHome);
+/* places BENCH_BLOCKS blocks on random Segments off the border of the virtual grid, and tries again until the flag can
+   be reached from the start space */
+void randomLayout(void)
+{
+    int i, j;       /* LCV's */
+    int placed;
+    Segment *block;
 
-        /* if there is no way to get home */
-        if (!fastestPath)
+    do {
+        for (i = 0; i < NUM_HORIZ_SEG_ROWS; ++i)
+            for (j = 0; j < NUM_HORIZ_SEG_COLS; ++j)
+                blockedHorizSeg[i][j] = UNBLOCKED;
+        for (i = 0; i < NUM_VERT_SEG_ROWS; ++i)
+            for (j = 0; j < NUM_VERT_SEG_COLS; ++j)
+                blockedVertSeg[i][j] = UNBLOCKED;
+
+        for (placed = 0; placed < BENCH_BLOCKS; )
         {
-            turnAbs(UP);
-            while (segAbs(UP) != BLOCKED)
-            {
-                moveForward();
-            }
-            /* TODO: Break out of this when you can calculate */
-            while (!(current[ROW] == 0 && current[COL] == 0))
+            block = virtualBlock(innerSegment(rand() % NUM_INNER_SEGMENTS));
+            if (*block != BLOCKED)
             {
-                turnAbs(LEFT);
-                wallHugUntil(RIGHT, inLeftMostColumnOrBottomRow, NULL);
-                turnAbs(RIGHT);
-                wallHugUntil(LEFT, inRightMostColumnOrTopRow, NULL);
+                *block = BLOCKED;
+                ++placed;
             }
-            break;
         }
-
-    } while (!followPath(*fastestPath ? (*fastestPath)->next : NULL));
+    } while (!flagReachable());
+    packBlockedSegments();
 
     return;
 }
-/* TEST ONLY */
-#ifdef VIRTUAL_BOT
 
-char *DirectionToStr(Direction dir)
+/* returns TRUE if there is a way from the start space to the flag around the blocks of the virtual grid */
+Bool flagReachable(void)
 {
-    switch (dir)
+    Bool seen[NUM_ROWS][NUM_COLS];
+    int stack[NUM_ROWS * NUM_COLS][2];  /* nodes seen but not searched from yet */
+    int top = 0;
+    int row, col;
+    Direction h;    /* LCV */
+    Segment wall;
+
+    for (row = 0; row < NUM_ROWS; ++row)
+        for (col = 0; col < NUM_COLS; ++col)
+            seen[row][col] = FALSE;
+    seen[0][0] = TRUE;
+    stack[top][ROW] = stack[top][COL] = 0;
+    ++top;
+
+    while (top > 0)
     {
-        case UP:    return "UP";        break;
-        case DOWN:  return "DOWN";      break;
-        case LEFT:  return "LEFT";      break;
-        case RIGHT: return "RIGHT";     break;
-        default:    return "INVALID";   break;
+        --top;
+        row = stack[top][ROW];
+        col = stack[top][COL];
+        if (row == NUM_ROWS - 1 && col == NUM_COLS - 1)
+            return TRUE;
+        for (h = UP; h < NUM_DIRECTIONS; ++h)
+        {
+            if (!segPtrAt(row, col, h))     /* grid border */
+                continue;
+            if (h == UP)
+                wall = blockedHorizSeg[row][col];
+            else if (h == DOWN)
+                wall = blockedHorizSeg[row + 1][col];
+            else if (h == LEFT)
+                wall = blockedVertSeg[row][col];
+            else /* h == RIGHT */
+                wall = blockedVertSeg[row][col + 1];
+            if (wall != BLOCKED && !seen[row + rowDelta[h]][col + colDelta[h]])
+            {
+                seen[row + rowDelta[h]][col + colDelta[h]] = TRUE;
+                stack[top][ROW] = row + rowDelta[h];
+                stack[top][COL] = col + colDelta[h];
+                ++top;
+            }
+        }
     }
+
+    return FALSE;
 }
 
-void displayPath(Path p)
+/* runs one mission from the start on the current layout -- with the planner of PLAN_TO_FLAG if plan, and with the
+   heuristic otherwise -- and records in flagMotions how many motions it took to capture the flag (0 if it never did),
+   and in flagHeading the heading it captured the flag with. Returns the number of ticks the mission took, or -1 if it
+   was stuck for BENCH_MAX_TICKS. */
+int benchRun(Bool plan, unsigned int *flagMotions, Direction *flagHeading)
 {
-    Path ptr = p; /* <<< SHOULDN'T NEED ptr BUT JUST WANTED TO MAKE SURE p WASN'T ALTERED */
-    printf("START");
-    while (ptr)
+    if (fastestPath)
     {
-        printf("(%d, %d)", ptr->tile.row, ptr->tile.col);
-        ptr = ptr->next;
+        freePath(fastestPath);
+        free(fastestPath);
+        fastestPath = NULL;
     }
-    printf("END\n");
+    initializeGlobalVariables();    /* haveFlag, direction, current, grid, horizSeg, vertSeg, route */
+    rolling = FALSE;
+    segmentsChanged = FALSE;
+    troubleSpot[ROW] = troubleSpot[COL] = 0;
+    stuck = FALSE;
+    motionCount = 0;
+    tickCount = 0;
+    planToFlag = plan;
+    *flagMotions = 0;
 
-    return;
-}
-void displayPathList(PathList pl)
-{
-    int i = 0;
-    PathList ptr = pl;
-    while (ptr)
+    checkForBlocks();   /* check for blocks surrounding start space -- MANDATORY */
+    mission = SEEK_DECIDE;
+    while (mission != MISSION_DONE && tickCount < BENCH_MAX_TICKS)
     {
-        printf("%d: ", i++);
-        displayPath(ptr->path);
-        ptr = ptr->next;
+        schedulerTick();
+        if (haveFlag && !*flagMotions)
+        {
+            *flagMotions = motionCount;
+            *flagHeading = direction;
+        }
     }
-    printf("\n");
-    return;
+    stopRolling();
+
+    return mission == MISSION_DONE ? (int)tickCount : -1;
 }
-int getTileIndex(int a, int b)
+#endif
+/*}}}*/
+/*{{{ LIBRARY API FUNCTIONS */
+#ifdef GRIDBOT_LIBRARY
+/* plans every query into the answer with the same index with the planner the robot uses (see planPath), and returns
+   how many found a path -- the robot's memory is only loaded again when a query's map differs from the last one, and
+   the queries know nothing of the enemy robot */
+int gridBotPlanBatch(const GridBotQuery *queries, GridBotAnswer *answers, int count)
 {
-    int i = 0;
-    Path ptr = *fastestPath;
-    while (ptr)
+    int i;                              /* LCV */
+    int found = 0;
+    const GridBotMap *loaded = NULL;    /* map in horizSeg and vertSeg */
+    const GridBotQuery *query;
+    GridBotAnswer *answer;
+    PlanResult plan;
+    int node;                           /* LCV: node of the plan */
+
+#ifdef TRACK_ENEMY
+    avoidEnemy = FALSE;
+#endif
+    for (i = 0; i < count; ++i)
     {
-        if (ptr->tile.row == a && ptr->tile.col == b)
-            return i;
-        else
+        query = &queries[i];
+        answer = &answers[i];
+        answer->found = FALSE;
+        answer->optimal = FALSE;
+        answer->motions = 0;
+        answer->length = 0;
+        if ((answer->error = checkQuery(query)) != GRIDBOT_OK)
+            continue;
+        if (query->map != loaded)
         {
-            ptr = ptr->next;
-            ++i;
+            loadModel(query->map);
+            loaded = query->map;
+        }
+        current[ROW] = query->start.row;
+        current[COL] = query->start.col;
+        direction = (Direction)query->start.heading;
+        planGoal[ROW] = query->goalRow;
+        planGoal[COL] = query->goalCol;
+        planThroughUnknown = query->throughUnknown ? TRUE : FALSE;
+
+        plan = planPath();
+        answer->found = plan.path != NULL;
+        answer->optimal = plan.optimal;
+        if (!plan.path)
+            continue;
+        for (node = 0; node < pathLength(*plan.path) && answer->length < GRIDBOT_MAX_PATH; ++node)
+        {
+            answer->path[answer->length].row = idRow((*plan.path)->id[node]);
+            answer->path[answer->length].col = idCol((*plan.path)->id[node]);
+            answer->path[answer->length].heading = idDir((*plan.path)->id[node]);
+            answer->motions = (*plan.path)->motions[node];
+            ++answer->length;
         }
+        if (node < pathLength(*plan.path))
+            ERROR("gridBotPlanBatch cut a path short at GRIDBOT_MAX_PATH nodes\n")
+        freePath(plan.path);
+        free(plan.path);
+        ++found;
     }
-    /* (a, b) not in fastestPath */
-    return -1;
+
+    return found;
 }
+
+/* returns GRIDBOT_OK if the planner can answer a query, or the reason it cannot -- a start or goal off the grid, or (built
+   without SPACE_TIME_PLAN) a goal other than home, which branch and bound cannot plan to */
+int checkQuery(const GridBotQuery *query)
+{
+    if (!validState(query->start))
+        return GRIDBOT_BAD_START;
+    else if (!onGrid(query->goalRow, query->goalCol))
+        return GRIDBOT_BAD_GOAL;
+#ifndef SPACE_TIME_PLAN
+    else if (query->goalRow != 0 || query->goalCol != 0)
+        return GRIDBOT_GOAL_NOT_HOME;
 #endif
-/* followPath takes a linked list of 2-dimensional arrays representing nodes on the grid and attempts to follow that path.
- * If robot successfully makes it to end of path, TRUE is returned; otherwise, FALSE (return with error)
- */
-Bool followPath(Path path)
+    else
+        return GRIDBOT_OK;
+}
+
+/* fills table with the fewest motions from start to every state over map (see costsFrom) -- returns GRIDBOT_BAD_START
+   (and leaves table alone) if start is off the grid */
+int gridBotCostsFrom(const GridBotMap *map, GridBotState start, int throughUnknown, GridBotCostTable *table)
 {
-    Direction dir;
+    if (!validState(start))
+        return GRIDBOT_BAD_START;
+    loadModel(map);
+    planThroughUnknown = throughUnknown ? TRUE : FALSE;
+    costsFrom(start.row, start.col, (Direction)start.heading, table->cost);
+
+    return GRIDBOT_OK;
+}
+
+/* fills table with the fewest motions from every state to node (goalRow, goalCol) over map (see costsTo) -- returns
+   GRIDBOT_BAD_GOAL (and leaves table alone) if the goal is off the grid */
+int gridBotCostsTo(const GridBotMap *map, int goalRow, int goalCol, int throughUnknown, GridBotCostTable *table)
+{
+    if (!onGrid(goalRow, goalCol))
+        return GRIDBOT_BAD_GOAL;
+    loadModel(map);
+    planThroughUnknown = throughUnknown ? TRUE : FALSE;
+    costsTo(goalRow, goalCol, table->cost);
+
+    return GRIDBOT_OK;
+}
+
+/* reads the sensors from every pose with the blocks of world in place (and no enemy robot), and records what they see
+   in the map with the same index -- the blocks are packed once for the whole batch. Returns how many poses were sensed:
+   the map of a pose off the grid is left alone. */
+int gridBotSenseBatch(const GridBotMap *world, const GridBotState *poses, GridBotMap *maps, int count)
+{
+    int i, j;   /* LCV's */
+    int sensed = 0;
+
+    for (i = 0; i < NUM_HORIZ_SEG_ROWS; ++i)
+        for (j = 0; j < NUM_HORIZ_SEG_COLS; ++j)
+            blockedHorizSeg[i][j] = (Segment)world->horiz[i][j];
+    for (i = 0; i < NUM_VERT_SEG_ROWS; ++i)
+        for (j = 0; j < NUM_VERT_SEG_COLS; ++j)
+            blockedVertSeg[i][j] = (Segment)world->vert[i][j];
+    packBlockedSegments();
+    enemy[ROW] = enemy[COL] = -NUM_ROWS - NUM_COLS;  /* off the grid, out of sight of every sensor */
 
-    while (path)
+    for (i = 0; i < count; ++i)
     {
-        /* next node is UP */
-        if ((current[ROW] == path->tile.row + 1) && (current[COL] == path->tile.col))
-            dir = UP;
-        /* next node is DOWN */
-        else if ((current[ROW] == path->tile.row - 1) && (current[COL] == path->tile.col))
-            dir = DOWN;
-        /* next node is LEFT */
-        else if ((current[ROW] == path->tile.row) && (current[COL] == path->tile.col + 1))
-            dir = LEFT;
-        /* next node is RIGHT */
-        else if ((current[ROW] == path->tile.row) && (current[COL] == path->tile.col - 1))
-            dir = RIGHT;
+        if (!validState(poses[i]))
+            continue;
+        loadModel(&maps[i]);
+        current[ROW] = poses[i].row;
+        current[COL] = poses[i].col;
+        direction = (Direction)poses[i].heading;
+        checkForBlocks();
+        storeModel(&maps[i]);
+        ++sensed;
+    }
 
-        /* TURN TO FACE APPROPRIATE DIRECTION */
-        turnAbs(dir);
+    return sensed;
+}
 
-        /* move to next node and scan for surrounding blocks if able, otherwise return with error */
-        if (segRel(FRONT) == BLOCKED)
-            return FALSE;
-        else
+/* loads a map into the robot's memory (horizSeg and vertSeg) as if it had been known all along -- none of its Segments
+   has a history of readings yet */
+void loadModel(const GridBotMap *map)
+{
+    int i, j;   /* LCV's */
+#ifdef SEGMENT_INFO
+    SegmentInfo blankInfo = { 0 };
+#endif
+
+    for (i = 0; i < NUM_HORIZ_SEG_ROWS; ++i)
+        for (j = 0; j < NUM_HORIZ_SEG_COLS; ++j)
         {
-            moveForward();
-            if (segmentsChanged)
-                return FALSE;
-            else
-                path = path->next;
+            horizSeg[i][j] = (Segment)map->horiz[i][j];
+#ifdef SEGMENT_INFO
+            horizSegInfo[i][j] = blankInfo;
+#endif
+        }
+    for (i = 0; i < NUM_VERT_SEG_ROWS; ++i)
+        for (j = 0; j < NUM_VERT_SEG_COLS; ++j)
+        {
+            vertSeg[i][j] = (Segment)map->vert[i][j];
+#ifdef SEGMENT_INFO
+            vertSegInfo[i][j] = blankInfo;
+#endif
         }
-    }
 
-    return TRUE;
+    return;
 }
+
+/* stores the robot's memory (horizSeg and vertSeg) into a map */
+void storeModel(GridBotMap *map)
+{
+    int i, j;   /* LCV's */
+
+    for (i = 0; i < NUM_HORIZ_SEG_ROWS; ++i)
+        for (j = 0; j < NUM_HORIZ_SEG_COLS; ++j)
+            map->horiz[i][j] = (unsigned char)horizSeg[i][j];
+    for (i = 0; i < NUM_VERT_SEG_ROWS; ++i)
+        for (j = 0; j < NUM_VERT_SEG_COLS; ++j)
+            map->vert[i][j] = (unsigned char)vertSeg[i][j];
+
+    return;
+}
+#endif
 /*}}}*/
-/*{{{ VIRTUAL OBJECT PRESENCE FUNCTIONS */
-#ifdef VIRTUAL_BOT
-/* returns status of adjacent segment, specified by absolute Direction (think of UP, RIGHT, DOWN, and LEFT and North,
-   THIS FUNCTION IS USED TO INDICATE THE PRESENCE OF A VIRTUAL GRID BLOCK */
-Segment blockedSegAbs(Direction absDir)
+/*{{{ TELEMETRY FUNCTIONS */
+#if defined(SEND_TELEMETRY) || defined(TELEMETRY_DECODER)
+Segment *tlmSegment(int index)
 {
-    if (absDir == UP)
-        return blockedHorizSeg[current[ROW]][current[COL]];
-    else if (absDir == DOWN)
-        return blockedHorizSeg[current[ROW] + 1][current[COL]];
-    else if (absDir == LEFT)
-        return blockedVertSeg[current[ROW]][current[COL]];
-    else /* absDir == RIGHT */
-        return blockedVertSeg[current[ROW]][current[COL] + 1];
+    if (index < NUM_HORIZ_SEGMENTS)
+        return &horizSeg[0][0] + index;
+    else
+        return &vertSeg[0][0] + (index - NUM_HORIZ_SEGMENTS);
 }
-
-/* returns status of adjacent segment, specified by relative Direction
-   THIS FUNCTION IS USED TO INDICATE THE PRESENCE OF A VIRTUAL GRID BLOCK */
-Segment blockedSegRel(Direction relSeg)
+#endif
+#ifdef SEND_TELEMETRY
+/* sends one telemetry frame: every Segment that is not the way the host was last told it is (TLM_FRAME_SEGMENTS at most),
+   TLM_REFRESH more Segments whether they changed or not (in turn), the robot's pose, TLM_FLAG once the flag is captured,
+   and TLM_FRAME_END -- a few bytes for a typical motion instead of an ASCII grid of about 450. If the frame is dropped
+   (see ASYNC_OUTPUT), what it held is sent again in the next one. */
+void sendTelemetry(void)
 {
-    Segment returnValue;
+    int i, n = 0;   /* LCV, and number of Segments in the frame */
+    unsigned char sent[TLM_FRAME_SEGMENTS]; /* telemetry indexes of the Segments in the frame */
+    Bool flag = FALSE;                      /* TRUE if the frame holds TLM_FLAG */
 
-    /* currently facing absolute UP */
-    if (direction == UP)
+    PROFILE_BEGIN(PROF_DISPLAY);
+    for (i = 0; i < TLM_REFRESH; ++i)
     {
-        returnValue = blockedSegAbs(relSeg); /* same as blockedSegAbs function */
+        tlmSent[tlmRefresh] = TLM_UNSENT;
+        tlmRefresh = (tlmRefresh + 1) % NUM_SEGMENTS;
     }
-    /* currently facing absolute DOWN */
-    else if (direction == DOWN)
+    serialBegin();
+    for (i = 0; i < NUM_SEGMENTS && n < TLM_FRAME_SEGMENTS; ++i)
+        if (tlmSent[i] != (unsigned char)*tlmSegment(i))
+        {
+            tlmSent[i] = (unsigned char)*tlmSegment(i);
+            serialPut(TLM_SEG + tlmSent[i]);
+            serialPut(i);
+            sent[n++] = (unsigned char)i;
+        }
+    serialPut(TLM_POSE + direction);
+    serialPut((current[ROW] << 4) | current[COL]);
+    if (haveFlag && !tlmFlagSent)
     {
-        if (relSeg == FRONT) /* absolute DOWN */
-            returnValue = blockedSegAbs(DOWN);
-        else if (relSeg == BACK) /* absolute UP */
-            returnValue = blockedSegAbs(UP);
-        else if (relSeg == LEFT) /* absolute RIGHT */
-            returnValue = blockedSegAbs(RIGHT);
-        else /* relSeg == RIGHT ---> absolute LEFT */
-            returnValue = blockedSegAbs(LEFT);
+        serialPut(TLM_FLAG);
+        tlmFlagSent = flag = TRUE;
     }
-    /* currently facing absolute LEFT */
-    else if (direction == LEFT)
+    serialPut(TLM_FRAME_END);
+    if (!serialEnd())
     {
-        if (relSeg == FRONT) /* absolute LEFT */
-            returnValue = blockedSegAbs(LEFT);
-        else if (relSeg == BACK) /* absolute RIGHT */
-            returnValue = blockedSegAbs(RIGHT);
-        else if (relSeg == LEFT) /* absolute DOWN */
-            returnValue = blockedSegAbs(DOWN);
-        else /* relSeg == RIGHT ---> absolute UP */
-            returnValue = blockedSegAbs(UP);
+        while (n > 0)
+            tlmSent[sent[--n]] = TLM_UNSENT;
+        if (flag)
+            tlmFlagSent = FALSE;
     }
-    /* currently facing absolute RIGHT */
-    else /* direction == RIGHT */
+    PROFILE_END(PROF_DISPLAY);
+
+    return;
+}
+#endif
+#ifdef TELEMETRY_DECODER
+/* reads a telemetry stream from standard input into the robot's memory and draws it after every frame -- a record that
+   is cut short by a lost byte is dropped, and the tag it was cut short by is read as the start of the next record */
+void decodeTelemetry(void)
+{
+    int c, payload;
+    unsigned int dropped = 0;   /* records cut short or not understood */
+
+    initializeGlobalVariables();    /* every Segment off the border is unknown until the first keyframe */
+    while ((c = getchar()) != EOF)
     {
-        if (relSeg == FRONT) /* absolute RIGHT */
-            returnValue = blockedSegAbs(RIGHT);
-        else if (relSeg == BACK) /* absolute LEFT */
-            returnValue = blockedSegAbs(LEFT);
-        else if (relSeg == LEFT) /* absolute UP */
-            returnValue = blockedSegAbs(UP);
-        else /* relSeg == RIGHT ---> absolute DOWN */
-            returnValue = blockedSegAbs(DOWN);
+        if (c < TLM_TAG)                        /* plain text between records */
+            putchar(c);
+        else if (c == TLM_FRAME_END)
+            displayDebugGrid();
+        else if (c == TLM_FLAG)
+            haveFlag = TRUE;
+        else if (c == TLM_DONE)
+            printf("*** Mission done ***\n");
+        else if (tlmKind(c) == TLM_SEG || tlmKind(c) == TLM_POSE)
+        {
+            if ((payload = getchar()) == EOF || payload >= TLM_TAG)
+            {
+                ++dropped;
+                if (payload != EOF)
+                    ungetc(payload, stdin);
+            }
+            else if (tlmKind(c) == TLM_POSE)
+            {
+                direction = (Direction)(c - TLM_POSE);
+                current[ROW] = payload >> 4;
+                current[COL] = payload & 0x0F;
+            }
+            else if (c - TLM_SEG <= IDK && payload < NUM_SEGMENTS)
+                *tlmSegment(payload) = (Segment)(c - TLM_SEG);
+            else
+                ++dropped;
+        }
+        else
+            ++dropped;
     }
+    if (dropped)
+        printf("telemetry: dropped %u records\n", dropped);
+    deallocateMemory();
 
-    return returnValue;
+    return;
 }
-
-#ifdef LONG_RANGE_SENSORS
-/* returns status of adjacent segment, specified by absolute Direction (think of UP, RIGHT, DOWN, and LEFT and North,
-   THIS FUNCTION IS USED TO INDICATE THE PRESENCE OF A VIRTUAL GRID BLOCK */
-Segment blockedSegAbs2(Direction absDir)
+#endif
+/*}}}*/
+/*{{{ SERIAL OUTPUT FUNCTIONS */
+#if defined(VIRTUAL_BOT) || defined(DEBUG_GRID)
+/* printf for the serial monitor -- with ASYNC_OUTPUT it only formats into txRing (SERIAL_LINE_LENGTH - 1 characters at
+   most, the rest is cut off) as one record, and returns before the first byte has gone out */
+int serialPrintf(const char *format, ...)
 {
-    if (absDir == UP)
-        return blockedHorizSeg[current[ROW] - 1][current[COL]];
-    else if (absDir == DOWN)
-        return blockedHorizSeg[current[ROW] + 2][current[COL]];
-    else if (absDir == LEFT)
-        return blockedVertSeg[current[ROW]][current[COL] - 1];
-    else /* absDir == RIGHT */
-        return blockedVertSeg[current[ROW]][current[COL] + 2];
+    va_list args;
+    int n;
+#ifdef TX_RING
+    static char line[SERIAL_LINE_LENGTH];   /* static: it would be the biggest stack frame on the AVR -- only the main loop prints */
+    int i;  /* LCV */
+#endif
+
+    va_start(args, format);
+#ifdef TX_RING
+    n = vsnprintf(line, SERIAL_LINE_LENGTH, format, args);
+    if (n > SERIAL_LINE_LENGTH - 1)
+        n = SERIAL_LINE_LENGTH - 1;
+    txBegin();
+    for (i = 0; i < n; ++i)
+        txPut(line[i]);
+    txEnd();
+#else
+    n = vprintf(format, args);
+#endif
+    va_end(args);
+
+    return n;
 }
+#endif
+#ifdef TX_RING
+#ifdef TX_THREAD
+pthread_t txThread;     /* consumer thread -- stands in for the UART interrupt */
 
-/* returns status of adjacent segment, specified by relative Direction
-   THIS FUNCTION IS USED TO INDICATE THE PRESENCE OF A VIRTUAL GRID BLOCK */
-Segment blockedSegRel2(Direction relSeg)
+/* sends a byte every SERIAL_BYTE_NS until stopTx(), and then whatever is left in txRing */
+void *txMain(void *dummy)
 {
-    Segment returnValue;
+    struct timespec byteTime;
 
-    /* currently facing absolute UP */
-    if (direction == UP)
-    {
-        returnValue = blockedSegAbs2(relSeg); /* same as blockedSegAbs2 function */
-    }
-    /* currently facing absolute DOWN */
-    else if (direction == DOWN)
-    {
-        if (relSeg == FRONT) /* absolute DOWN */
-            returnValue = blockedSegAbs2(DOWN);
-        else if (relSeg == BACK) /* absolute UP */
-            returnValue = blockedSegAbs2(UP);
-        else if (relSeg == LEFT) /* absolute RIGHT */
-            returnValue = blockedSegAbs2(RIGHT);
-        else /* relSeg == RIGHT ---> absolute LEFT */
-            returnValue = blockedSegAbs2(LEFT);
-    }
-    /* currently facing absolute LEFT */
-    else if (direction == LEFT)
-    {
-        if (relSeg == FRONT) /* absolute LEFT */
-            returnValue = blockedSegAbs2(LEFT);
-        else if (relSeg == BACK) /* absolute RIGHT */
-            returnValue = blockedSegAbs2(RIGHT);
-        else if (relSeg == LEFT) /* absolute DOWN */
-            returnValue = blockedSegAbs2(DOWN);
-        else /* relSeg == RIGHT ---> absolute UP */
-            returnValue = blockedSegAbs2(UP);
-    }
-    /* currently facing absolute RIGHT */
-    else /* direction == RIGHT */
+    byteTime.tv_sec = 0;
+    byteTime.tv_nsec = SERIAL_BYTE_NS;
+    while (txDrain() || txRunning)
+        nanosleep(&byteTime, NULL);
+    return NULL;
+}
+#endif
+
+/* starts emptying txRing in the background */
+void startTx(void)
+{
+    txRunning = TRUE;
+#ifdef TX_THREAD
+    if (pthread_create(&txThread, NULL, txMain, NULL))
     {
-        if (relSeg == FRONT) /* absolute RIGHT */
-            returnValue = blockedSegAbs2(RIGHT);
-        else if (relSeg == BACK) /* absolute LEFT */
-            returnValue = blockedSegAbs2(LEFT);
-        else if (relSeg == LEFT) /* absolute UP */
-            returnValue = blockedSegAbs2(UP);
-        else /* relSeg == RIGHT ---> absolute DOWN */
-            returnValue = blockedSegAbs2(DOWN);
+        fputs("Failed to start the serial output thread -- no serial output\n", stderr);
+        txRunning = FALSE;
     }
+#else
+    /* LL: set up the UART and enable its data register empty interrupt here, with an ISR that calls txDrain() and
+     *     disables the interrupt again when txDrain() returns FALSE (e.g. ISR(USART_UDRE_vect)) */
+#endif
 
-    return returnValue;
+    return;
 }
-#endif
 
-/* returns TRUE or FALSE, depending on whether or not the enemy robot is occupying the segment in the absolute direction
-   away from the current segment (1 node away) */
-Bool enemyPresenceAbs(Direction absDir)
+/* sends whatever is left in txRing and stops emptying it */
+void stopTx(void)
 {
-    if (absDir == UP && current[ROW] > 0)
-        return enemy[ROW] == current[ROW] - 1 && enemy[COL] == current[COL] ? TRUE : FALSE;
-    else if (absDir == DOWN && current[ROW] < NUM_ROWS - 1)
-        return enemy[ROW] == current[ROW] + 1 && enemy[COL] == current[COL] ? TRUE : FALSE;
-    else if (absDir == LEFT && current[COL] > 0)
-        return enemy[ROW] == current[ROW] && enemy[COL] == current[COL] - 1 ? TRUE : FALSE;
-    else if (absDir == RIGHT && current[COL] < NUM_COLS - 1)
-        return enemy[ROW] == current[ROW] && enemy[COL] == current[COL] + 1 ? TRUE : FALSE;
-    else
-        return FALSE;
+    if (!txRunning)
+        return;
+    txRunning = FALSE;
+#ifdef TX_THREAD
+    pthread_join(txThread, NULL);
+    if (txDropped)
+        printf("async output: dropped %u records\n", txDropped);
+#else
+    /* LL: wait here until txHead == txTail, then disable the UART interrupt */
+#endif
+
+    return;
 }
 
-/* same as enemyPresenceAbs, except direction is specified in relative terms instead of absolute */
-Bool enemyPresenceRel(Direction relSeg)
+/* PRODUCER: starts a record -- its bytes go in after the last whole record */
+void txBegin(void)
 {
-    Bool returnValue;
+    txPending = txHead;
+    txOverflow = FALSE;
 
-    /* currently facing absolute UP */
-    if (direction == UP)
-    {
-        returnValue = enemyPresenceAbs(relSeg); /* same as enemyPresenceAbs function */
-    }
-    /* currently facing absolute DOWN */
-    else if (direction == DOWN)
-    {
-        if (relSeg == FRONT) /* absolute DOWN */
-            returnValue = enemyPresenceAbs(DOWN);
-        else if (relSeg == BACK) /* absolute UP */
-            returnValue = enemyPresenceAbs(UP);
-        else if (relSeg == LEFT) /* absolute RIGHT */
-            returnValue = enemyPresenceAbs(RIGHT);
-        else /* relSeg == RIGHT ---> absolute LEFT */
-            returnValue = enemyPresenceAbs(LEFT);
-    }
-    /* currently facing absolute LEFT */
-    else if (direction == LEFT)
-    {
-        if (relSeg == FRONT) /* absolute LEFT */
-            returnValue = enemyPresenceAbs(LEFT);
-        else if (relSeg == BACK) /* absolute RIGHT */
-            returnValue = enemyPresenceAbs(RIGHT);
-        else if (relSeg == LEFT) /* absolute DOWN */
-            returnValue = enemyPresenceAbs(DOWN);
-        else /* relSeg == RIGHT ---> absolute UP */
-            returnValue = enemyPresenceAbs(UP);
-    }
-    /* currently facing absolute RIGHT */
-    else /* direction == RIGHT */
+    return;
+}
+
+/* PRODUCER: pushes a byte of the record onto txRing if there is room for it, and otherwise marks the record as dropped
+   -- never waits */
+void txPut(int c)
+{
+    if (txOverflow || (unsigned char)(txPending - txTail) >= TX_RING_SIZE)
+        txOverflow = TRUE;
+    else
     {
-        if (relSeg == FRONT) /* absolute RIGHT */
-            returnValue = enemyPresenceAbs(RIGHT);
-        else if (relSeg == BACK) /* absolute LEFT */
-            returnValue = enemyPresenceAbs(LEFT);
-        else if (relSeg == LEFT) /* absolute UP */
-            returnValue = enemyPresenceAbs(UP);
-        else /* relSeg == RIGHT ---> absolute DOWN */
-            returnValue = enemyPresenceAbs(DOWN);
+        txRing[txPending % TX_RING_SIZE] = (unsigned char)c;
+        ++txPending;
     }
 
-    return returnValue;
+    return;
 }
 
-#ifdef LONG_RANGE_SENSORS
-/* returns TRUE or FALSE, depending on whether or not the enemy robot is occupying the segment in the absolute direction
-   away from the current segment (2 nodes away) */
-Bool enemyPresenceAbs2(Direction absDir)
+/* PRODUCER: hands the record to the consumer -- returns FALSE (and counts the record in txDropped) if it did not fit */
+Bool txEnd(void)
 {
-    if (absDir == UP && current[ROW] > 1)
-        return enemy[ROW] == current[ROW] - 2 && enemy[COL] == current[COL] ? TRUE : FALSE;
-    else if (absDir == DOWN && current[ROW] < NUM_ROWS - 2)
-        return enemy[ROW] == current[ROW] + 2 && enemy[COL] == current[COL] ? TRUE : FALSE;
-    else if (absDir == LEFT && current[COL] > 1)
-        return enemy[ROW] == current[ROW] && enemy[COL] == current[COL] - 2 ? TRUE : FALSE;
-    else if (absDir == RIGHT && current[COL] < NUM_COLS - 2)
-        return enemy[ROW] == current[ROW] && enemy[COL] == current[COL] + 2 ? TRUE : FALSE;
-    else
+    if (txOverflow)
+    {
+        ++txDropped;
         return FALSE;
+    }
+    MEMORY_BARRIER()                /* the bytes must be in place before the consumer can see them */
+    txHead = txPending;
+#ifndef TX_THREAD
+    /* LL: enable the UART data register empty interrupt here, in case it disabled itself on an empty txRing */
+#endif
+
+    return TRUE;
 }
 
-/* same as enemyPresenceAbs2, except direction is specified in relative terms instead of absolute */
-Bool enemyPresenceRel2(Direction relSeg)
+/* CONSUMER: pops the oldest byte off txRing and sends it -- returns FALSE if txRing was empty */
+Bool txDrain(void)
 {
-    Bool returnValue;
+    unsigned char tail = txTail, c;
 
-    /* currently facing absolute UP */
-    if (direction == UP)
-    {
-        returnValue = enemyPresenceAbs2(relSeg); /* same as enemyPresenceAbs2 function */
-    }
-    /* currently facing absolute DOWN */
-    else if (direction == DOWN)
-    {
-        if (relSeg == FRONT) /* absolute DOWN */
-            returnValue = enemyPresenceAbs2(DOWN);
-        else if (relSeg == BACK) /* absolute UP */
-            returnValue = enemyPresenceAbs2(UP);
-        else if (relSeg == LEFT) /* absolute RIGHT */
-            returnValue = enemyPresenceAbs2(RIGHT);
-        else /* relSeg == RIGHT ---> absolute LEFT */
-            returnValue = enemyPresenceAbs2(LEFT);
-    }
-    /* currently facing absolute LEFT */
-    else if (direction == LEFT)
-    {
-        if (relSeg == FRONT) /* absolute LEFT */
-            returnValue = enemyPresenceAbs2(LEFT);
-        else if (relSeg == BACK) /* absolute RIGHT */
-            returnValue = enemyPresenceAbs2(RIGHT);
-        else if (relSeg == LEFT) /* absolute DOWN */
-            returnValue = enemyPresenceAbs2(DOWN);
-        else /* relSeg == RIGHT ---> absolute UP */
-            returnValue = enemyPresenceAbs2(UP);
-    }
-    /* currently facing absolute RIGHT */
-    else /* direction == RIGHT */
-    {
-        if (relSeg == FRONT) /* absolute RIGHT */
-            returnValue = enemyPresenceAbs2(RIGHT);
-        else if (relSeg == BACK) /* absolute LEFT */
-            returnValue = enemyPresenceAbs2(LEFT);
-        else if (relSeg == LEFT) /* absolute UP */
-            returnValue = enemyPresenceAbs2(UP);
-        else /* relSeg == RIGHT ---> absolute DOWN */
-            returnValue = enemyPresenceAbs2(DOWN);
-    }
+    if (tail == txHead)
+        return FALSE;
+    c = txRing[tail % TX_RING_SIZE];
+    MEMORY_BARRIER()                /* the byte must be read before the producer can write over it */
+    txTail = (unsigned char)(tail + 1);
+#ifdef TX_THREAD
+    putchar(c);
+#else
+    /* LL: write c to the UART data register here (e.g. UDR0 = c) */
+#endif
 
-    return returnValue;
+    return TRUE;
 }
 #endif
+/*}}}*/
+/*{{{ PROFILING FUNCTIONS */
+#if defined(PROFILE) && (defined(VIRTUAL_BOT) || defined(DEBUG_GRID))
+/* prints one line per profiled function: its calls, and the total, average and slowest PROFILE_NOW ticks they took --
+   the counters keep running, so every summary covers the run so far. Each line goes out with serialPrintf, so with
+   ASYNC_OUTPUT it is one record of txRing and never lands inside a telemetry frame. */
+void profileDump(void)
+{
+    int s;  /* LCV */
+
+    serialPrintf("profile   calls     ticks       avg       max\n");
+    for (s = 0; s < NUM_PROF_SECTIONS; ++s)
+        serialPrintf("%-7s %7u %9lu %9lu %9lu\n", profNames[s], profCalls[s], profTotal[s],
+                     profCalls[s] ? profTotal[s] / profCalls[s] : 0UL, profMax[s]);
 
+    return;
+}
 #endif
-/* }}} */
+/*}}}*/
 /*{{{ CONSOLE OUTPUT TEST FUNCTIONS */
 #ifdef VIRTUAL_BOT
 /* FUNCTION displayGrid
@@ -2015,6 +4949,9 @@ void displayGrid(void)
     int i, j;           /* LCV's */
     int idx;            /* index of return home tile */
     Bool displayCursor; /* whether or not to display cursor on segment */
+#ifdef TRACK_ENEMY
+    int guess[2];       /* most likely node of the enemy robot */
+#endif
 
     CLEAR
     if (setupMode)
@@ -2025,7 +4962,12 @@ void displayGrid(void)
     else
     {
         printf("current: %d, %d\t", current[ROW], current[COL]);
-        printf("enemy: %d, %d\n", enemy[ROW], enemy[COL]);
+        printf("enemy: %d, %d", enemy[ROW], enemy[COL]);
+#ifdef TRACK_ENEMY
+        enemyBestGuess(guess);
+        printf("\ttracked: %d, %d", guess[ROW], guess[COL]);
+#endif
+        printf("\n");
     }
 
     /* display header */
@@ -2169,7 +5111,7 @@ void displayGrid(void)
         }
         else
         {
-            if (vertSeg[i][NUM_VERT_SEG_COLS] == UNBLOCKED)
+            if (vertSeg[i][NUM_VERT_SEG_COLS - 1] == UNBLOCKED)
                 printf("|\n%*s ", rowNumWidth, "");
             else /* BLOCKED */
                 printf("#\n%*s ", rowNumWidth, "");
@@ -2220,6 +5162,9 @@ void controlEnemyRobot(void)
         else if (ctrlLeft(buffer))   moveEnemyRobot(LEFT);
         else if (ctrlRight(buffer))  moveEnemyRobot(RIGHT);
         else if (ctrlDone(buffer))   { printf("\b*** Stopped ***\n"); exit(0); }
+    #ifdef PROFILE
+        else if (ctrlProfile(buffer)) { profileDump(); waitForEnter(); }
+    #endif
     } while(!advanceRobot(buffer));
 
     return;
@@ -2270,6 +5215,7 @@ void moveEnemyRobot(Direction dirToMove)
                 ERROR("Received an invalid direction in function moveEnemyRobot\n")
                 break;
     };
+    poseChanged();  /* the sensors see the enemy robot too */
 
     return;
 }
@@ -2420,7 +5366,8 @@ int getline(char *line, int max)
     pauseAndClear(); /* TEST */
 }
 
-#elif defined(DEBUG_GRID)
+#endif
+#if defined(DEBUG_GRID) && (!defined(VIRTUAL_BOT) || defined(TELEMETRY_DECODER))
 
 /* FUNCTION:     displayDebugGrid
    DESCRIPTION:  Displays the robot's memory of the physical grid and spacial parameters on a serial monitor while
@@ -2461,11 +5408,12 @@ void displayDebugGrid(void)
 {
     int i, j;           /* LCV's */
 
+    PROFILE_BEGIN(PROF_DISPLAY);
     CLEAR
-    printf("current: %d, %d\n", current[ROW], current[COL]);
+    serialPrintf("current: %d, %d\n", current[ROW], current[COL]);
 
     /* display header */
-    printf("    0   1   2   3   4   5\n  ");
+    serialPrintf("    0   1   2   3   4   5\n  ");
 
     /* display bulk of grid */
     for (i = 0; i < NUM_ROWS; ++i)
@@ -2473,16 +5421,16 @@ void displayDebugGrid(void)
         /* horizontal segments */
         for (j = 0; j < NUM_COLS; ++j)
         {
-            printf("+");
+            serialPrintf("+");
             switch (horizSeg[i][j])
             {
-                case IDK:       printf("???"); break;
-                case BLOCKED:   printf("###"); break;
-                case UNBLOCKED: printf("---"); break;
+                case IDK:       serialPrintf("???"); break;
+                case BLOCKED:   serialPrintf("###"); break;
+                case UNBLOCKED: serialPrintf("---"); break;
                 /* no default -- we make no errors! */
             }
         }
-        printf("+\n%d ", i); /* new line and row number */
+        serialPrintf("+\n%d ", i); /* new line and row number */
 
         /* vertical segments and node information */
         for (j = 0; j < NUM_COLS; ++j)
@@ -2490,9 +5438,9 @@ void displayDebugGrid(void)
             /* segments */
             switch (vertSeg[i][j])
             {
-                case IDK:       printf("? "); break;
-                case BLOCKED:   printf("# "); break;
-                case UNBLOCKED: printf("| "); break;
+                case IDK:       serialPrintf("? "); break;
+                case BLOCKED:   serialPrintf("# "); break;
+                case UNBLOCKED: serialPrintf("| "); break;
                 /* no default -- we make no errors! */
             }
 
@@ -2500,36 +5448,36 @@ void displayDebugGrid(void)
             if (i == current[ROW] && j == current[COL])     /* display robot */
             {
                 if (direction == UP)
-                    printf("^ ");
+                    serialPrintf("^ ");
                 else if (direction == DOWN)
-                    printf("v ");
+                    serialPrintf("v ");
                 else if (direction == LEFT)
-                    printf("< ");
+                    serialPrintf("< ");
                 else /* direction == RIGHT */
-                    printf("> ");
+                    serialPrintf("> ");
             }
             else if (haveFlag == FALSE && i == NUM_ROWS - 1 && j == NUM_COLS - 1)
             {
-                printf("F ");
+                serialPrintf("F ");
             }
             #ifdef REMEMBER_VISITED_NODES
             else if (grid[i][j] == VISITED) /* display VISITED indicator */
             {
-                printf(". ");
+                serialPrintf(". ");
             }
             #endif
             else /* display blank -- UNVISITED indicator */
             {
-                printf("  ");
+                serialPrintf("  ");
             }
         } /* for */
 
         /* last column of vertical segments */
         switch (vertSeg[i][NUM_COLS])
         {
-            case IDK:       printf("? \n  "); break; /* this should never evaluate to TRUE */
-            case BLOCKED:   printf("# \n  "); break;
-            case UNBLOCKED: printf("| \n  "); break;
+            case IDK:       serialPrintf("? \n  "); break; /* this should never evaluate to TRUE */
+            case BLOCKED:   serialPrintf("# \n  "); break;
+            case UNBLOCKED: serialPrintf("| \n  "); break;
             /* no default -- we make no errors! */
         }
     }
@@ -2537,19 +5485,20 @@ void displayDebugGrid(void)
     /* last row of horizontal segments */
     for (j = 0; j < NUM_COLS; ++j)
     {
-        printf("+");
+        serialPrintf("+");
         switch (horizSeg[NUM_ROWS][j])
         {
-            case IDK:       printf("???"); break; /* this should never evaluate to TRUE */
-            case BLOCKED:   printf("###"); break;
-            case UNBLOCKED: printf("---"); break;
+            case IDK:       serialPrintf("???"); break; /* this should never evaluate to TRUE */
+            case BLOCKED:   serialPrintf("###"); break;
+            case UNBLOCKED: serialPrintf("---"); break;
             /* no default -- we make no errors! */
         }
     }
-    printf("+\n  Test Mode\n");
+    serialPrintf("+\n  Test Mode\n");
 
     if (haveFlag)
-        printf("CAPTURED THE FLAG!\n");
+        serialPrintf("CAPTURED THE FLAG!\n");
+    PROFILE_END(PROF_DISPLAY);
 
     return;
 }
@@ -0,0 +1,89 @@
+/* GridBot.h -- C API of GridBot.c built as a library (see GRIDBOT_LIBRARY in GridBot.c)
+ *
+ * The world model, the sensors of the virtual grid and the planners of the robot, for offline tools that need to ask
+ * them many questions at once: every call answers a whole batch of queries, and reuses the same scratch buffers (the
+ * robot's memory, the planner's tables, the packed virtual blocks) for all of them instead of setting them up again.
+ *
+ * The library is built from the same global state as the robot, so it is not reentrant: make one call at a time.
+ */
+#ifndef GRIDBOT_H
+#define GRIDBOT_H
+
+#define GRIDBOT_ROWS        7                               /* must match NUM_ROWS in GridBot.c */
+#define GRIDBOT_COLS        6                               /* must match NUM_COLS in GridBot.c */
+#define GRIDBOT_MAX_PATH    (GRIDBOT_ROWS * GRIDBOT_COLS)   /* nodes in the longest path a plan can return */
+
+/* values of a segment in a GridBotMap -- same as Segment in GridBot.c */
+#define GRIDBOT_BLOCKED     0
+#define GRIDBOT_UNBLOCKED   1
+#define GRIDBOT_IDK         2
+
+/* headings of a GridBotState -- same as Direction in GridBot.c */
+#define GRIDBOT_UP          0
+#define GRIDBOT_RIGHT       1
+#define GRIDBOT_DOWN        2
+#define GRIDBOT_LEFT        3
+
+typedef struct
+{
+    unsigned char horiz[GRIDBOT_ROWS + 1][GRIDBOT_COLS];    /* horizontal segments, same layout as horizSeg */
+    unsigned char vert[GRIDBOT_ROWS][GRIDBOT_COLS + 1];     /* vertical segments, same layout as vertSeg */
+} GridBotMap;           /* what the robot knows of the grid, or where the blocks of a virtual grid really are */
+
+typedef struct
+{
+    int row;
+    int col;
+    int heading;        /* GRIDBOT_UP, GRIDBOT_RIGHT, GRIDBOT_DOWN, or GRIDBOT_LEFT */
+} GridBotState;         /* position and orientation of the robot */
+
+typedef struct
+{
+    const GridBotMap *map;  /* what the robot knows -- queries in a row that share a map only load it once */
+    GridBotState start;
+    int goalRow;
+    int goalCol;
+    int throughUnknown;     /* nonzero if the path may cross GRIDBOT_IDK segments (at UNKNOWN_PENALTY extra motions) */
+} GridBotQuery;         /* one question for the planner: the fastest path from start to the goal over map */
+
+/* values of GridBotAnswer.error and of the cost table calls -- why the library could not answer */
+#define GRIDBOT_OK              0   /* answered */
+#define GRIDBOT_BAD_START       1   /* start is off the grid, or its heading is not a GRIDBOT_ heading */
+#define GRIDBOT_BAD_GOAL        2   /* goal is off the grid */
+#define GRIDBOT_GOAL_NOT_HOME   3   /* built without SPACE_TIME_PLAN: branch and bound can only plan to (0, 0) */
+
+typedef struct
+{
+    int error;          /* GRIDBOT_OK, or why the query was not planned (found is then zero) */
+    int found;          /* nonzero if there is a path */
+    int optimal;        /* nonzero if the planner proved the path fastest (it may run out of PLAN_BUDGET first) */
+    int motions;        /* planned motions (moves, 90 degree turns, and waits) plus the risk of the moves */
+    int length;         /* number of nodes in path, start included */
+    GridBotState path[GRIDBOT_MAX_PATH];    /* nodes of the path, each with the heading the robot enters it with */
+} GridBotAnswer;        /* the planner's answer to one GridBotQuery */
+
+#define GRIDBOT_UNREACHED   255     /* cost of a state in a GridBotCostTable that cannot be reached (or reach the goal) */
+
+typedef struct
+{
+    unsigned char cost[GRIDBOT_ROWS][GRIDBOT_COLS][4];  /* [row][col][heading]: fewest motions, or GRIDBOT_UNREACHED */
+} GridBotCostTable;     /* answers to every query of one sweep, priced like GridBotAnswer.motions */
+
+/* plans every query (count of them) into the answer with the same index, returns how many found a path -- a query the
+   planner cannot answer gets an error in its answer instead */
+int gridBotPlanBatch(const GridBotQuery *queries, GridBotAnswer *answers, int count);
+
+/* single source, every target: fills table with the fewest motions from start to every state over map, in one sweep --
+   returns GRIDBOT_OK, or GRIDBOT_BAD_START */
+int gridBotCostsFrom(const GridBotMap *map, GridBotState start, int throughUnknown, GridBotCostTable *table);
+
+/* every source, single target: fills table with the fewest motions from every state to node (goalRow, goalCol) over
+   map, arriving with any heading, in one sweep -- returns GRIDBOT_OK, or GRIDBOT_BAD_GOAL */
+int gridBotCostsTo(const GridBotMap *map, int goalRow, int goalCol, int throughUnknown, GridBotCostTable *table);
+
+/* reads the sensors from every pose (count of them) with the blocks of world in place, and records what they see in
+   the map with the same index -- each map starts as what the robot knew before the reading. Returns how many poses were
+   sensed: the map of a pose off the grid is left alone. */
+int gridBotSenseBatch(const GridBotMap *world, const GridBotState *poses, GridBotMap *maps, int count);
+
+#endif
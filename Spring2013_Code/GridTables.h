@@ -0,0 +1,106 @@
+/* GridTables.h -- grid tables of GridBot.c (see Grid Tables there), included once by GridBot.c
+ *
+ * GENERATED by gentables.sh for a 7 by 6 grid -- do not edit by hand, run gentables.sh again instead.
+ */
+#define TABLE_ROWS 7     /* grid the tables were generated for */
+#define TABLE_COLS 6
+const unsigned char nodeNeighbour[NUM_NODES][NUM_DIRECTIONS] FLASH_TABLE =
+{
+    { NO_NODE,       1,       6, NO_NODE },    /* node 0: (0, 0) */
+    { NO_NODE,       2,       7,       0 },    /* node 1: (0, 1) */
+    { NO_NODE,       3,       8,       1 },    /* node 2: (0, 2) */
+    { NO_NODE,       4,       9,       2 },    /* node 3: (0, 3) */
+    { NO_NODE,       5,      10,       3 },    /* node 4: (0, 4) */
+    { NO_NODE, NO_NODE,      11,       4 },    /* node 5: (0, 5) */
+    {       0,       7,      12, NO_NODE },    /* node 6: (1, 0) */
+    {       1,       8,      13,       6 },    /* node 7: (1, 1) */
+    {       2,       9,      14,       7 },    /* node 8: (1, 2) */
+    {       3,      10,      15,       8 },    /* node 9: (1, 3) */
+    {       4,      11,      16,       9 },    /* node 10: (1, 4) */
+    {       5, NO_NODE,      17,      10 },    /* node 11: (1, 5) */
+    {       6,      13,      18, NO_NODE },    /* node 12: (2, 0) */
+    {       7,      14,      19,      12 },    /* node 13: (2, 1) */
+    {       8,      15,      20,      13 },    /* node 14: (2, 2) */
+    {       9,      16,      21,      14 },    /* node 15: (2, 3) */
+    {      10,      17,      22,      15 },    /* node 16: (2, 4) */
+    {      11, NO_NODE,      23,      16 },    /* node 17: (2, 5) */
+    {      12,      19,      24, NO_NODE },    /* node 18: (3, 0) */
+    {      13,      20,      25,      18 },    /* node 19: (3, 1) */
+    {      14,      21,      26,      19 },    /* node 20: (3, 2) */
+    {      15,      22,      27,      20 },    /* node 21: (3, 3) */
+    {      16,      23,      28,      21 },    /* node 22: (3, 4) */
+    {      17, NO_NODE,      29,      22 },    /* node 23: (3, 5) */
+    {      18,      25,      30, NO_NODE },    /* node 24: (4, 0) */
+    {      19,      26,      31,      24 },    /* node 25: (4, 1) */
+    {      20,      27,      32,      25 },    /* node 26: (4, 2) */
+    {      21,      28,      33,      26 },    /* node 27: (4, 3) */
+    {      22,      29,      34,      27 },    /* node 28: (4, 4) */
+    {      23, NO_NODE,      35,      28 },    /* node 29: (4, 5) */
+    {      24,      31,      36, NO_NODE },    /* node 30: (5, 0) */
+    {      25,      32,      37,      30 },    /* node 31: (5, 1) */
+    {      26,      33,      38,      31 },    /* node 32: (5, 2) */
+    {      27,      34,      39,      32 },    /* node 33: (5, 3) */
+    {      28,      35,      40,      33 },    /* node 34: (5, 4) */
+    {      29, NO_NODE,      41,      34 },    /* node 35: (5, 5) */
+    {      30,      37, NO_NODE, NO_NODE },    /* node 36: (6, 0) */
+    {      31,      38, NO_NODE,      36 },    /* node 37: (6, 1) */
+    {      32,      39, NO_NODE,      37 },    /* node 38: (6, 2) */
+    {      33,      40, NO_NODE,      38 },    /* node 39: (6, 3) */
+    {      34,      41, NO_NODE,      39 },    /* node 40: (6, 4) */
+    {      35, NO_NODE, NO_NODE,      40 }     /* node 41: (6, 5) */
+};
+Segment *const nodeSegment[NUM_NODES][NUM_DIRECTIONS] FLASH_TABLE =
+{
+    { NULL,            &vertSeg[0][1],  &horizSeg[1][0], NULL },
+    { NULL,            &vertSeg[0][2],  &horizSeg[1][1], &vertSeg[0][1] },
+    { NULL,            &vertSeg[0][3],  &horizSeg[1][2], &vertSeg[0][2] },
+    { NULL,            &vertSeg[0][4],  &horizSeg[1][3], &vertSeg[0][3] },
+    { NULL,            &vertSeg[0][5],  &horizSeg[1][4], &vertSeg[0][4] },
+    { NULL,            NULL,            &horizSeg[1][5], &vertSeg[0][5] },
+    { &horizSeg[1][0], &vertSeg[1][1],  &horizSeg[2][0], NULL },
+    { &horizSeg[1][1], &vertSeg[1][2],  &horizSeg[2][1], &vertSeg[1][1] },
+    { &horizSeg[1][2], &vertSeg[1][3],  &horizSeg[2][2], &vertSeg[1][2] },
+    { &horizSeg[1][3], &vertSeg[1][4],  &horizSeg[2][3], &vertSeg[1][3] },
+    { &horizSeg[1][4], &vertSeg[1][5],  &horizSeg[2][4], &vertSeg[1][4] },
+    { &horizSeg[1][5], NULL,            &horizSeg[2][5], &vertSeg[1][5] },
+    { &horizSeg[2][0], &vertSeg[2][1],  &horizSeg[3][0], NULL },
+    { &horizSeg[2][1], &vertSeg[2][2],  &horizSeg[3][1], &vertSeg[2][1] },
+    { &horizSeg[2][2], &vertSeg[2][3],  &horizSeg[3][2], &vertSeg[2][2] },
+    { &horizSeg[2][3], &vertSeg[2][4],  &horizSeg[3][3], &vertSeg[2][3] },
+    { &horizSeg[2][4], &vertSeg[2][5],  &horizSeg[3][4], &vertSeg[2][4] },
+    { &horizSeg[2][5], NULL,            &horizSeg[3][5], &vertSeg[2][5] },
+    { &horizSeg[3][0], &vertSeg[3][1],  &horizSeg[4][0], NULL },
+    { &horizSeg[3][1], &vertSeg[3][2],  &horizSeg[4][1], &vertSeg[3][1] },
+    { &horizSeg[3][2], &vertSeg[3][3],  &horizSeg[4][2], &vertSeg[3][2] },
+    { &horizSeg[3][3], &vertSeg[3][4],  &horizSeg[4][3], &vertSeg[3][3] },
+    { &horizSeg[3][4], &vertSeg[3][5],  &horizSeg[4][4], &vertSeg[3][4] },
+    { &horizSeg[3][5], NULL,            &horizSeg[4][5], &vertSeg[3][5] },
+    { &horizSeg[4][0], &vertSeg[4][1],  &horizSeg[5][0], NULL },
+    { &horizSeg[4][1], &vertSeg[4][2],  &horizSeg[5][1], &vertSeg[4][1] },
+    { &horizSeg[4][2], &vertSeg[4][3],  &horizSeg[5][2], &vertSeg[4][2] },
+    { &horizSeg[4][3], &vertSeg[4][4],  &horizSeg[5][3], &vertSeg[4][3] },
+    { &horizSeg[4][4], &vertSeg[4][5],  &horizSeg[5][4], &vertSeg[4][4] },
+    { &horizSeg[4][5], NULL,            &horizSeg[5][5], &vertSeg[4][5] },
+    { &horizSeg[5][0], &vertSeg[5][1],  &horizSeg[6][0], NULL },
+    { &horizSeg[5][1], &vertSeg[5][2],  &horizSeg[6][1], &vertSeg[5][1] },
+    { &horizSeg[5][2], &vertSeg[5][3],  &horizSeg[6][2], &vertSeg[5][2] },
+    { &horizSeg[5][3], &vertSeg[5][4],  &horizSeg[6][3], &vertSeg[5][3] },
+    { &horizSeg[5][4], &vertSeg[5][5],  &horizSeg[6][4], &vertSeg[5][4] },
+    { &horizSeg[5][5], NULL,            &horizSeg[6][5], &vertSeg[5][5] },
+    { &horizSeg[6][0], &vertSeg[6][1],  NULL,            NULL },
+    { &horizSeg[6][1], &vertSeg[6][2],  NULL,            &vertSeg[6][1] },
+    { &horizSeg[6][2], &vertSeg[6][3],  NULL,            &vertSeg[6][2] },
+    { &horizSeg[6][3], &vertSeg[6][4],  NULL,            &vertSeg[6][3] },
+    { &horizSeg[6][4], &vertSeg[6][5],  NULL,            &vertSeg[6][4] },
+    { &horizSeg[6][5], NULL,            NULL,            &vertSeg[6][5] }
+};
+const unsigned char homeBound[NUM_NODES] FLASH_TABLE =
+{
+     0,  1,  2,  3,  4,  5,
+     1,  2,  3,  4,  5,  6,
+     2,  3,  4,  5,  6,  7,
+     3,  4,  5,  6,  7,  8,
+     4,  5,  6,  7,  8,  9,
+     5,  6,  7,  8,  9, 10,
+     6,  7,  8,  9, 10, 11
+};
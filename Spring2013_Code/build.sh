@@ -1,17 +1,40 @@
 #!/bin/bash
-gcc -ansi -pedantic GridBot.c -o VirtualBot 2> errlog
+gcc -ansi -pedantic -pthread GridBot.c -o VirtualBot 2> errlog
 if [ -s errlog ]
 then
     cat errlog
 else
     sed 's|^#define VIRTUAL_BOT|/\* #define VIRTUAL_BOT \*/|g' < GridBot.c > avr.c
-    gcc -ansi -pedantic avr.c -o AVRBot 2> errlog
-    rm avr.c
+    gcc -ansi -pedantic -pthread -fstack-usage -fcallgraph-info=su -c avr.c -o avr.o 2> errlog
+    gcc -pthread avr.o -o AVRBot 2>> errlog
+    mv avr.su AVRBot.su
+    mv avr.ci AVRBot.ci
+    rm avr.c avr.o
     if [ -s errlog ]
     then
         cat errlog
     else
-        sh size.sh
+        sed 's|^/\* #define GRIDBOT_LIBRARY \*/|#define GRIDBOT_LIBRARY|g' < GridBot.c > lib.c
+        gcc -ansi -pedantic -pthread -O2 -c lib.c -o GridBot.o 2> errlog
+        rm lib.c
+        if [ -s errlog ]
+        then
+            cat errlog
+        else
+            # only the API of GridBot.h is global in the library -- everything else is made local, as if it were static
+            objcopy -w --keep-global-symbol='gridBot*' GridBot.o
+            ar rcs libGridBot.a GridBot.o
+            rm GridBot.o
+            sed 's|^/\* #define TELEMETRY_DECODER \*/|#define TELEMETRY_DECODER|g' < GridBot.c > decoder.c
+            gcc -ansi -pedantic -pthread decoder.c -o TelemetryDecoder 2> errlog
+            rm decoder.c
+            if [ -s errlog ]
+            then
+                cat errlog
+            else
+                sh size.sh
+            fi
+        fi
     fi
 fi
 rm errlog
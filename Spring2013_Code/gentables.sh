@@ -0,0 +1,54 @@
+#!/bin/sh
+# Generates GridTables.h, the grid tables GridBot.c includes (nodeNeighbour, nodeSegment and homeBound), for the NUM_ROWS
+# and NUM_COLS GridBot.c #defines -- run by hand after changing the size of the grid, and commit the result. The build
+# never runs it: GridBot.c fails to compile (tableGridCheck) while GridTables.h is out of date.
+awk '
+/^#define NUM_ROWS / { rows = $3 }
+/^#define NUM_COLS / { cols = $3 }
+NR == 1 { cr = $0 ~ /\r$/ ? "\r" : "" }
+END {
+    if (!rows || !cols)
+    {
+        print "gentables.sh: no NUM_ROWS or NUM_COLS in GridBot.c" > "/dev/stderr"
+        exit 1
+    }
+    printf "/* GridTables.h -- grid tables of GridBot.c (see Grid Tables there), included once by GridBot.c%s\n", cr
+    printf " *%s\n", cr
+    printf " * GENERATED by gentables.sh for a %d by %d grid -- do not edit by hand, run gentables.sh again instead.%s\n", rows, cols, cr
+    printf " */%s\n", cr
+    printf "#define TABLE_ROWS %d     /* grid the tables were generated for */%s\n", rows, cr
+    printf "#define TABLE_COLS %d%s\n", cols, cr
+    printf "const unsigned char nodeNeighbour[NUM_NODES][NUM_DIRECTIONS] FLASH_TABLE =%s\n{%s\n", cr, cr
+    for (r = 0; r < rows; ++r)
+        for (c = 0; c < cols; ++c)
+        {
+            n = r * cols + c
+            printf "    { %7s, %7s, %7s, %7s }%s    /* node %d: (%d, %d) */%s\n",
+                   (r < 1 ? "NO_NODE" : n - cols), (c > cols - 2 ? "NO_NODE" : n + 1),
+                   (r > rows - 2 ? "NO_NODE" : n + cols), (c < 1 ? "NO_NODE" : n - 1),
+                   (n < rows * cols - 1 ? "," : " "), n, r, c, cr
+        }
+    printf "};%s\n", cr
+    printf "Segment *const nodeSegment[NUM_NODES][NUM_DIRECTIONS] FLASH_TABLE =%s\n{%s\n", cr, cr
+    for (r = 0; r < rows; ++r)
+        for (c = 0; c < cols; ++c)
+        {
+            n = r * cols + c
+            printf "    { %-16s %-16s %-16s %-4s }%s%s\n",
+                   (r < 1 ? "NULL" : "&horizSeg[" r "][" c "]") ",",
+                   (c > cols - 2 ? "NULL" : "&vertSeg[" r "][" c + 1 "]") ",",
+                   (r > rows - 2 ? "NULL" : "&horizSeg[" r + 1 "][" c "]") ",",
+                   (c < 1 ? "NULL" : "&vertSeg[" r "][" c "]"),
+                   (n < rows * cols - 1 ? "," : ""), cr
+        }
+    printf "};%s\n", cr
+    printf "const unsigned char homeBound[NUM_NODES] FLASH_TABLE =%s\n{%s\n", cr, cr
+    for (r = 0; r < rows; ++r)
+    {
+        printf "   "
+        for (c = 0; c < cols; ++c)
+            printf " %2d%s", r + c, (r < rows - 1 || c < cols - 1 ? "," : "")
+        printf "%s\n", cr
+    }
+    printf "};%s\n", cr
+}' GridBot.c > GridTables.h.new && mv GridTables.h.new GridTables.h || rm -f GridTables.h.new
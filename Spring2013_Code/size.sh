@@ -1,2 +1,97 @@
 echo "VirtualBot: `stat -c %s VirtualBot` bytes"
 echo "AVRBot:     `stat -c %s AVRBot` bytes"
+echo "libGridBot.a: `stat -c %s libGridBot.a` bytes"
+echo "TelemetryDecoder: `stat -c %s TelemetryDecoder` bytes"
+# The stack reports below come from the host gcc (-fstack-usage and -fcallgraph-info of the PC build of AVRBot), not from
+# avr-gcc: they are an approximation of the AVR, where pointers are 2 bytes instead of 8 and an int is 2 instead of 4.
+echo "AVRBot stack usage, host x86-64 approximation (bytes per frame, deepest first):"
+sort -t '	' -k2 -n -r AVRBot.su | head -n 10 | awk -F '	' '{ n = split($1, f, ":"); printf "  %-32s %5s  %s\n", f[n], $2, $3 }'
+echo "Path helpers (one frame each, whatever the path length):"
+grep -E ':(copyPath|appendPathNode|pruneTree|pathListNodeContainingTile|tileInPathList|getNumDigits)	' AVRBot.su | awk -F '	' '{ n = split($1, f, ":"); printf "  %-32s %5s  %s\n", f[n], $2, $3 }'
+# Worst-case stack per call chain: the deepest sum of frames along any chain of calls out of each root, from the call
+# graph in AVRBot.ci. Calls through a function pointer are resolved with INDIRECT (caller=the functions its table holds),
+# which must be kept up to date with tasks, sensors, turnTo and the wall hug conditions -- an indirect call it does not
+# cover, or a recursive chain, is reported on standard error instead of a bound. Library calls (printf, malloc, ...)
+# count as 0 bytes.
+echo "Worst-case stack per call chain, host x86-64 approximation (library calls not counted):"
+awk -v roots="main missionTask outputTask senseTask branchAndBound planPath" \
+    -v indirect="schedulerTick=missionTask,outputTask,senseTask senseSegments=readRangeSensor turnAbs=turnRight,turn180,turnLeft wallHugStep=inRightMostColumnOrTopRow,inLeftMostColumnOrBottomRow,inRightCol_OR_OpeningBelow,inLeftCol_OR_OpeningBelowToLeft,inBottomRow_OR_OpeningToRight,inTopRow_OR_OpeningToRightUpAbove" '
+function quoted(s, key)
+{
+    s = substr(s, index(s, key ": \"") + length(key) + 3)
+    return substr(s, 1, index(s, "\"") - 1)
+}
+function addCall(from, to)
+{
+    callee[from, ++calls[from]] = to
+}
+# deepest stack of a call to f (its frame and the deepest of its callees), memoized in worst[]; via[f] is the callee
+# the deepest chain goes through
+function depth(f,   i, d, c)
+{
+    if (f in worst)
+        return worst[f]
+    if (onChain[f])
+    {
+        print "size.sh: recursive call chain through " f " -- no bound" > "/dev/stderr"
+        recursive = 1
+        return 0
+    }
+    onChain[f] = 1
+    d = 0
+    for (i = 1; i <= calls[f]; ++i)
+    {
+        c = depth(callee[f, i])
+        if (c > d)
+        {
+            d = c
+            via[f] = callee[f, i]
+        }
+    }
+    onChain[f] = 0
+    worst[f] = frame[f] + d
+    return worst[f]
+}
+BEGIN {
+    n = split(indirect, entries, " ")
+    for (i = 1; i <= n; ++i)
+    {
+        split(entries[i], pair, "=")
+        targets[pair[1]] = pair[2]
+    }
+}
+/^node:/ && / bytes / {
+    label = $0
+    sub(/ bytes .*/, "", label)
+    sub(/.*\\n/, "", label)
+    frame[quoted($0, "title")] = label + 0
+}
+/^edge:/ {
+    from = quoted($0, "sourcename")
+    to = quoted($0, "targetname")
+    if (to != "__indirect_call")
+        addCall(from, to)
+    else if (from in targets)
+    {
+        m = split(targets[from], list, ",")
+        for (i = 1; i <= m; ++i)
+            addCall(from, list[i])
+    }
+    else
+    {
+        print "size.sh: indirect call in " from " is not in INDIRECT -- its bound leaves it out" > "/dev/stderr"
+        recursive = 1
+    }
+}
+END {
+    n = split(roots, list, " ")
+    for (i = 1; i <= n; ++i)
+    {
+        d = depth(list[i])
+        chain = list[i]
+        for (f = list[i]; f in via; f = via[f])
+            chain = chain " > " via[f]
+        printf "  %-32s %5d  %s\n", list[i], d, chain
+    }
+    exit recursive
+}' AVRBot.ci